@@ -0,0 +1,90 @@
+#include "Checkpoint.h"
+#include <cstdio>
+#include <exception>
+
+CheckpointWriter::CheckpointWriter(PresetParser* prepar, std::string path)
+    : _prepar(prepar), _path(path)
+{
+    _thread = std::thread(&CheckpointWriter::writerLoop, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _pending_cv.notify_all();
+    _thread.join();
+}
+
+// Copy is made under the lock, writer holds it only to swap buffers
+void CheckpointWriter::Submit(Field* field, uint64_t generation)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _pending = *field;
+        _pending_generation = generation;
+        _has_pending = true;
+    }
+    _pending_cv.notify_one();
+}
+
+void CheckpointWriter::writerLoop()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _pending_cv.wait(lock, [this] { return _has_pending || _stop; });
+        if (!_has_pending) return;
+
+        if (_writing.getN() != _pending.getN() || _writing.getM() != _pending.getM())
+            _writing.Resize(_pending.getN(), _pending.getM());
+        _writing.Swap(_pending);
+        uint64_t generation = _pending_generation;
+        _has_pending = false;
+        _busy = true;
+        lock.unlock();
+
+        std::string error;
+        std::string temp = _path + ".tmp";
+        try
+        {
+            _prepar->SaveSnapshot(&_writing, temp, generation);
+#ifdef _WIN32
+            // rename() does not replace existing files on Windows
+            std::remove(_path.c_str());
+#endif
+            if (std::rename(temp.c_str(), _path.c_str()) != 0)
+                error = "Can't rename checkpoint to " + _path;
+        }
+        catch (const std::exception& e)
+        {
+            error = e.what();
+        }
+
+        lock.lock();
+        _busy = false;
+        if (error.empty()) _written++;
+        else               _error = error;
+        _idle_cv.notify_all();
+    }
+}
+
+void CheckpointWriter::Wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle_cv.wait(lock, [this] { return !_has_pending && !_busy; });
+}
+
+long long CheckpointWriter::GetWritten()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _written;
+}
+
+std::string CheckpointWriter::GetError()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _error;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "Life.h"
+
+/// <summary>
+/// Writes snapshots of a running simulation on a background thread.
+/// Submit() copies the field into a pending buffer and returns,
+/// writer thread swaps it with its own buffer and saves it, so the
+/// simulation never waits for disk. A newer field submitted before
+/// the pending one was taken replaces it.
+/// Snapshot goes to a temporary file renamed over path when complete,
+/// so path always holds a whole checkpoint
+/// </summary>
+class CheckpointWriter
+{
+private:
+    PresetParser* _prepar;
+    std::string _path;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::condition_variable _pending_cv, _idle_cv;
+
+    Field _pending, _writing;
+    uint64_t _pending_generation = 0;
+    bool _has_pending = false;
+    bool _busy = false;
+    bool _stop = false;
+    long long _written = 0;
+    std::string _error;
+
+    void writerLoop();
+
+public:
+    // Name, comment and rule of snapshots are taken from prepar
+    CheckpointWriter(PresetParser* prepar, std::string path);
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+    // Writes pending checkpoint and stops writer thread
+    ~CheckpointWriter();
+
+    void Submit(Field* field, uint64_t generation);
+    // Blocks until every submitted checkpoint is written
+    void Wait();
+    // Number of checkpoints written so far
+    long long GetWritten();
+    // Message of the last failed write, empty if none failed
+    std::string GetError();
+};
@@ -0,0 +1,150 @@
+#include "ConsoleInput.h"
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <thread>
+#include <chrono>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#include <conio.h>
+#else
+#include <unistd.h>
+#include <poll.h>
+#include <termios.h>
+#endif
+
+#define BACKSPACE_CHAR 0x08
+#define DELETE_CHAR 0x7F
+
+#ifndef _WIN32
+// Terminal mode before ConsoleInput changed it
+static struct termios saved_mode;
+static volatile sig_atomic_t mode_changed = 0;
+
+static void restoreTerminal()
+{
+    if (mode_changed)
+        tcsetattr(0, TCSANOW, &saved_mode);
+    mode_changed = 0;
+}
+
+// Only async-signal-safe calls, signal is raised again with default action
+static void restoreOnSignal(int sig)
+{
+    restoreTerminal();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+#endif
+
+ConsoleInput::ConsoleInput()
+{
+#ifdef _WIN32
+    _terminal = _isatty(0) != 0;
+#else
+    _terminal = isatty(0) && tcgetattr(0, &saved_mode) == 0;
+    if (!_terminal) return;
+    struct termios raw = saved_mode;
+    raw.c_lflag &= ~(ICANON | ECHO);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(0, TCSANOW, &raw) != 0) return;
+    mode_changed = 1;
+    static bool handlers_set = false;
+    if (!handlers_set)
+    {
+        std::atexit(restoreTerminal);
+        signal(SIGINT, restoreOnSignal);
+        signal(SIGTERM, restoreOnSignal);
+        handlers_set = true;
+    }
+#endif
+}
+
+ConsoleInput::~ConsoleInput()
+{
+#ifndef _WIN32
+    restoreTerminal();
+#endif
+}
+
+void ConsoleInput::feed(char c, std::vector<std::string>& lines)
+{
+    // Enter gives '\r' on Windows console, '\r' of "\r\n" lines is dropped
+    if (c == '\n' || (c == '\r' && _terminal))
+    {
+        lines.push_back(_pending);
+        _pending.clear();
+    }
+    else if (c == BACKSPACE_CHAR || c == DELETE_CHAR)
+    {
+        if (!_pending.empty()) _pending.pop_back();
+    }
+    else if (c == '\t' || (unsigned char)c >= 0x20)
+        _pending += c;
+}
+
+bool ConsoleInput::Poll(int timeout_ms, std::vector<std::string>& lines)
+{
+    if (_eof)
+    {
+        // Nothing to wait for, caller still expects the pause
+        std::this_thread::sleep_for(std::chrono::milliseconds(timeout_ms));
+        return false;
+    }
+    char buffer[256];
+    int got = 0;
+#ifdef _WIN32
+    HANDLE in = GetStdHandle(STD_INPUT_HANDLE);
+    DWORD start = GetTickCount();
+    while (true)
+    {
+        if (_terminal)
+        {
+            while (_kbhit() && got < (int)sizeof(buffer))
+                buffer[got++] = (char)_getch();
+        }
+        else if (GetFileType(in) == FILE_TYPE_PIPE)
+        {
+            // Pipe: read only what is already there
+            DWORD available = 0;
+            if (!PeekNamedPipe(in, NULL, 0, NULL, &available, NULL))
+                _eof = true;
+            else if (available > 0)
+                got = _read(0, buffer, available < sizeof(buffer) ? (unsigned int)available : sizeof(buffer));
+        }
+        else
+        {
+            // Reading a file does not block for long
+            got = _read(0, buffer, sizeof(buffer));
+            if (got <= 0) _eof = true;
+        }
+        if (got < 0) got = 0;
+        if (got > 0 || _eof || (int)(GetTickCount() - start) >= timeout_ms) break;
+        Sleep(1);
+    }
+#else
+    struct pollfd in = { 0, POLLIN, 0 };
+    if (poll(&in, 1, timeout_ms) <= 0)
+        return false;
+    ssize_t size = read(0, buffer, sizeof(buffer));
+    if (size < 0 && errno == EINTR)
+        return false;
+    if (size <= 0) _eof = true;
+    else got = (int)size;
+#endif
+    for (int i = 0; i < got; i++)
+        feed(buffer[i], lines);
+    // Last line of input may lack its line break
+    if (_eof && !_pending.empty())
+    {
+        lines.push_back(_pending);
+        _pending.clear();
+    }
+    return got > 0 || _eof;
+}
+
+const std::string& ConsoleInput::GetPending() { return _pending;  }
+bool ConsoleInput::AtEof()                    { return _eof;      }
+bool ConsoleInput::IsTerminal()               { return _terminal; }
@@ -0,0 +1,36 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/// <summary>
+/// Reads command lines from standard input without blocking.
+/// On a terminal, line editing and echo of the terminal are turned off
+/// while the object lives: typed text is kept here, so the caller can
+/// redraw it in every frame, backspace edits it.
+/// Terminal mode is restored by destructor, at exit and on SIGINT/SIGTERM
+/// </summary>
+class ConsoleInput
+{
+private:
+    std::string _pending;
+    bool _terminal = false;
+    bool _eof = false;
+
+    // Adds typed byte to pending text, complete line goes to lines
+    void feed(char c, std::vector<std::string>& lines);
+
+public:
+    ConsoleInput();
+    ConsoleInput(const ConsoleInput&) = delete;
+    ConsoleInput& operator=(const ConsoleInput&) = delete;
+    ~ConsoleInput();
+
+    // Waits at most timeout_ms for input and appends lines completed by it
+    // True if anything was read, pending text may have changed then
+    bool Poll(int timeout_ms, std::vector<std::string>& lines);
+    // Text typed after the last complete line
+    const std::string& GetPending();
+    // Input is closed, no more lines will come
+    bool AtEof();
+    bool IsTerminal();
+};
@@ -0,0 +1,130 @@
+#include "CycleDetector.h"
+
+// Index has at least twice as many slots as history, power of two
+CycleDetector::CycleDetector(size_t window)
+    : _window(window < 1 ? 1 : window), _ring(_window)
+{
+    size_t slots = 4;
+    while (slots < _window * 2) slots *= 2;
+    _index.assign(slots, Seen{ 0, 0, 0 });
+}
+
+void CycleDetector::Reset()
+{
+    if (_index_used > 0) _epoch++;
+    _index_used = 0;
+    _count = 0;
+    _has_candidate = false;
+    _period = 0;
+    _start = 0;
+}
+
+uint64_t CycleDetector::hashAt(uint64_t generation) { return _ring[generation % _window]; }
+
+size_t CycleDetector::findSlot(uint64_t hash)
+{
+    size_t mask = _index.size() - 1;
+    size_t slot = (size_t)(hash * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+    while (_index[slot].epoch == _epoch && _index[slot].hash != hash)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+bool CycleDetector::lastSeen(uint64_t hash, uint64_t* generation)
+{
+    const Seen& seen = _index[findSlot(hash)];
+    if (seen.epoch != _epoch || seen.generation < _first_generation) return false;
+    *generation = seen.generation;
+    return true;
+}
+
+void CycleDetector::insertIndex(uint64_t hash, uint64_t generation)
+{
+    size_t slot = findSlot(hash);
+    if (_index[slot].epoch != _epoch)
+    {
+        // At most 3/4 of slots are used, so probe sequences stay short and end
+        if ((_index_used + 1) * 4 > _index.size() * 3)
+        {
+            rebuildIndex();
+            slot = findSlot(hash);
+        }
+        _index_used++;
+    }
+    _index[slot] = Seen{ hash, generation, _epoch };
+}
+
+void CycleDetector::rebuildIndex()
+{
+    _epoch++;
+    _index_used = 0;
+    for (uint64_t g = _first_generation; g < _first_generation + _count; g++)
+    {
+        size_t slot = findSlot(hashAt(g));
+        if (_index[slot].epoch != _epoch) _index_used++;
+        _index[slot] = Seen{ hashAt(g), g, _epoch };
+    }
+}
+
+// Hashes older than window are dropped from the ring, their index entries become stale
+void CycleDetector::record(uint64_t hash, uint64_t generation)
+{
+    if (_count == 0 || _first_generation + _count != generation)
+    {
+        Reset();
+        _first_generation = generation;
+    }
+    if (_count == _window)
+    {
+        _first_generation++;
+        _count--;
+    }
+    _ring[generation % _window] = hash;
+    _count++;
+    insertIndex(hash, generation);
+}
+
+bool CycleDetector::Observe(Logic* logic)
+{
+    if (_period != 0) return true;
+
+    Field* field = logic->GetField();
+    uint64_t generation = logic->GetGeneration();
+    uint64_t hash = logic->GetStateHash();
+
+    if (_has_candidate && generation == _candidate_generation + _candidate_period)
+    {
+        _has_candidate = false;
+        if (field->Equals(_candidate))
+        {
+            // Cycle starts where hashes stop repeating one period apart
+            _period = _candidate_period;
+            uint64_t start = _candidate_generation;
+            while (start > _first_generation && hashAt(start - 1) == hashAt(start - 1 + _period))
+                start--;
+            _start = start;
+            record(hash, generation);
+            return true;
+        }
+    }
+    else if (_has_candidate && generation > _candidate_generation + _candidate_period)
+        _has_candidate = false;
+
+    if (!_has_candidate)
+    {
+        uint64_t seen;
+        if (lastSeen(hash, &seen) && seen < generation)
+        {
+            _candidate = *field;
+            _candidate_generation = generation;
+            _candidate_period = generation - seen;
+            _has_candidate = true;
+        }
+    }
+    record(hash, generation);
+    return false;
+}
+
+bool CycleDetector::Found() { return _period != 0; }
+uint64_t CycleDetector::GetPeriod() { return _period; }
+uint64_t CycleDetector::GetStart() { return _start; }
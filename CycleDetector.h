@@ -0,0 +1,77 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "Life.h"
+
+// Generations kept in history of CycleDetector, longer periods are not found
+#define CYCLE_HISTORY (1 << 16)
+
+/// <summary>
+/// Finds the generation from which a simulation repeats itself.
+/// Every observed generation is recorded by its state hash (Logic::GetStateHash),
+/// a repeated hash makes a candidate period. Candidate is confirmed by
+/// comparing cells of the field one period later, so hash collisions
+/// never give a false cycle. Only the last CYCLE_HISTORY generations are kept.
+/// History is a ring of hashes with an open addressing index, both sized
+/// once by the constructor, so observing generations allocates nothing
+/// </summary>
+class CycleDetector
+{
+private:
+    // Index slot: latest generation with given hash,
+    // slots of other epochs than the current one are empty
+    typedef struct Seen_s
+    {
+        uint64_t hash;
+        uint64_t generation;
+        uint64_t epoch;
+    } Seen;
+
+    size_t _window;
+    // Hashes of generations _first_generation .. + _count - 1,
+    // hash of generation g is at g % _window
+    std::vector<uint64_t> _ring;
+    size_t _count = 0;
+    uint64_t _first_generation = 0;
+    // Entries older than _first_generation are stale, they are skipped
+    // by lookups and reused by inserts, the index is rebuilt when full
+    // Reset and rebuild empty all slots at once by starting a new epoch
+    std::vector<Seen> _index;
+    size_t _index_used = 0;
+    uint64_t _epoch = 1;
+
+    // Field at _candidate_generation, expected again one period later
+    Field _candidate;
+    uint64_t _candidate_generation = 0;
+    uint64_t _candidate_period = 0;
+    bool _has_candidate = false;
+
+    uint64_t _period = 0;
+    uint64_t _start = 0;
+
+    void record(uint64_t hash, uint64_t generation);
+    uint64_t hashAt(uint64_t generation);
+    // Slot of hash, or the empty slot ending its probe sequence
+    size_t findSlot(uint64_t hash);
+    // Latest generation with given hash inside history, false if there is none
+    bool lastSeen(uint64_t hash, uint64_t* generation);
+    void insertIndex(uint64_t hash, uint64_t generation);
+    // Index of generations in history only
+    void rebuildIndex();
+
+public:
+    CycleDetector(size_t window = CYCLE_HISTORY);
+
+    // Records current generation of logic, generations must be observed one by one
+    // True once the cycle is confirmed, after that further calls change nothing
+    bool Observe(Logic* logic);
+    // Forgets history, for example after the field was edited
+    void Reset();
+
+    bool Found();
+    // Smallest period of the cycle, 1 for still lifes
+    uint64_t GetPeriod();
+    // First generation which is repeated every period
+    uint64_t GetStart();
+};
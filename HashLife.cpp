@@ -0,0 +1,412 @@
+#include "HashLife.h"
+#include <stdexcept>
+
+#define NO_NODE 0xFFFFFFFFu
+#define DEAD_LEAF 0
+#define ALIVE_LEAF 1
+// Smallest root: 8x8 cells
+#define MIN_ROOT_LEVEL 3
+// Root never grows past it, coordinates stay inside int64_t
+#define MAX_ROOT_LEVEL 62
+
+static inline uint64_t hashChildren(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se)
+{
+    uint64_t h = nw;
+    h = h * 0x9E3779B97F4A7C15ull + ne;
+    h = h * 0x9E3779B97F4A7C15ull + sw;
+    h = h * 0x9E3779B97F4A7C15ull + se;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+// b_mask/s_mask: bit k is set if k neighbours give birth/survival
+HashLife::HashLife(uint16_t b_mask, uint16_t s_mask)
+{
+    SetRule(b_mask, s_mask);
+    Clear();
+}
+
+// Memoized results of the old rule are dropped, cells stay
+void HashLife::SetRule(uint16_t b_mask, uint16_t s_mask)
+{
+    if (b_mask & 1)
+        throw std::invalid_argument("HashLife does not support B0 rules");
+
+    // Base case: 4x4 square, bit (r * 4 + c), next state of cells (1..2, 1..2)
+    // Same rule as Logic: alive && survive || birth
+    for (int cells = 0; cells < (1 << 16); cells++)
+    {
+        uint8_t res = 0;
+        for (int r = 1; r <= 2; r++)
+        {
+            for (int c = 1; c <= 2; c++)
+            {
+                int sum = 0;
+                for (int dr = -1; dr <= 1; dr++)
+                    for (int dc = -1; dc <= 1; dc++)
+                        if ((dr != 0 || dc != 0) && (cells >> ((r + dr) * 4 + c + dc)) & 1)
+                            sum++;
+                bool alive = (cells >> (r * 4 + c)) & 1;
+                bool next = ((b_mask >> sum) & 1) || (alive && ((s_mask >> sum) & 1));
+                if (next) res |= 1 << ((r - 1) * 2 + (c - 1));
+            }
+        }
+        _base[cells] = res;
+    }
+
+    for (Node& node : _nodes)
+        node.result = NO_NODE;
+    _slow_results.clear();
+}
+
+void HashLife::Clear()
+{
+    _nodes.clear();
+    _nodes.push_back(Node{ NO_NODE, NO_NODE, NO_NODE, NO_NODE, NO_NODE, 0, 0 });
+    _nodes.push_back(Node{ NO_NODE, NO_NODE, NO_NODE, NO_NODE, NO_NODE, 0, 1 });
+    _table.assign(1 << 16, NO_NODE);
+    _table_used = 0;
+    _empty.clear();
+    _empty.push_back(DEAD_LEAF);
+    _slow_results.clear();
+    _root = emptyNode(MIN_ROOT_LEVEL);
+    _generation = 0;
+}
+
+#pragma region NodeTable
+
+void HashLife::insertTable(uint32_t id)
+{
+    const Node& n = _nodes[id];
+    size_t mask = _table.size() - 1;
+    size_t slot = hashChildren(n.nw, n.ne, n.sw, n.se) & mask;
+    while (_table[slot] != NO_NODE)
+        slot = (slot + 1) & mask;
+    _table[slot] = id;
+    _table_used++;
+}
+
+void HashLife::growTable()
+{
+    _table.assign(_table.size() * 2, NO_NODE);
+    _table_used = 0;
+    for (uint32_t id = 2; id < _nodes.size(); id++)
+        insertTable(id);
+}
+
+// Canonical node with given children
+uint32_t HashLife::join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se)
+{
+    size_t mask = _table.size() - 1;
+    size_t slot = hashChildren(nw, ne, sw, se) & mask;
+    while (_table[slot] != NO_NODE)
+    {
+        const Node& n = _nodes[_table[slot]];
+        if (n.nw == nw && n.ne == ne && n.sw == sw && n.se == se)
+            return _table[slot];
+        slot = (slot + 1) & mask;
+    }
+
+    if (_nodes.size() >= NO_NODE)
+        throw std::length_error("HashLife node table is full");
+
+    uint64_t population = _nodes[nw].population + _nodes[ne].population
+                        + _nodes[sw].population + _nodes[se].population;
+    uint32_t id = (uint32_t)_nodes.size();
+    _nodes.push_back(Node{ nw, ne, sw, se, NO_NODE, _nodes[nw].level + 1, population });
+    _table[slot] = id;
+    _table_used++;
+    if (_table_used * 2 > _table.size())
+        growTable();
+    return id;
+}
+
+uint32_t HashLife::emptyNode(uint32_t level)
+{
+    while (_empty.size() <= level)
+    {
+        uint32_t e = _empty.back();
+        _empty.push_back(join(e, e, e, e));
+    }
+    return _empty[level];
+}
+
+#pragma endregion
+
+#pragma region Evolution
+
+// Root placed in the center of twice bigger empty square
+void HashLife::expand()
+{
+    Node r = _nodes[_root];
+    if (r.level >= MAX_ROOT_LEVEL)
+        throw std::overflow_error("HashLife universe is too big");
+    uint32_t e = emptyNode(r.level - 1);
+    uint32_t nw = join(e, e, e, r.nw);
+    uint32_t ne = join(e, e, r.ne, e);
+    uint32_t sw = join(e, r.sw, e, e);
+    uint32_t se = join(r.se, e, e, e);
+    _root = join(nw, ne, sw, se);
+}
+
+// True if live cells of root are inside the center of its center (1/16 of root area)
+// Successor keeps only the central quarter, so the pattern needs a margin
+// of a quarter of root size on every side to grow or move into
+bool HashLife::rootCentred()
+{
+    return _nodes[centre(centre(_root))].population == _nodes[_root].population;
+}
+
+// Center square of node, one level lower
+uint32_t HashLife::centre(uint32_t id)
+{
+    Node n = _nodes[id];
+    return join(_nodes[n.nw].se, _nodes[n.ne].sw, _nodes[n.sw].ne, _nodes[n.se].nw);
+}
+
+// Square between west and east neighbour nodes
+uint32_t HashLife::horizontalCentre(uint32_t w, uint32_t e)
+{
+    Node wn = _nodes[w], en = _nodes[e];
+    return join(wn.ne, en.nw, wn.se, en.sw);
+}
+
+// Square between north and south neighbour nodes
+uint32_t HashLife::verticalCentre(uint32_t n, uint32_t s)
+{
+    Node nn = _nodes[n], sn = _nodes[s];
+    return join(nn.sw, nn.se, sn.nw, sn.ne);
+}
+
+// Level 2 node: center 2x2 after one generation by lookup table
+uint32_t HashLife::baseSuccessor(uint32_t id)
+{
+    Node n = _nodes[id];
+    uint32_t quads[4] = { n.nw, n.ne, n.sw, n.se };
+    int cells = 0;
+    for (int q = 0; q < 4; q++)
+    {
+        const Node& c = _nodes[quads[q]];
+        int r0 = (q / 2) * 2, c0 = (q % 2) * 2;
+        cells |= (int)_nodes[c.nw].population << (r0 * 4 + c0);
+        cells |= (int)_nodes[c.ne].population << (r0 * 4 + c0 + 1);
+        cells |= (int)_nodes[c.sw].population << ((r0 + 1) * 4 + c0);
+        cells |= (int)_nodes[c.se].population << ((r0 + 1) * 4 + c0 + 1);
+    }
+    uint8_t res = _base[cells];
+    return join(res & 1 ? ALIVE_LEAF : DEAD_LEAF, res & 2 ? ALIVE_LEAF : DEAD_LEAF,
+                res & 4 ? ALIVE_LEAF : DEAD_LEAF, res & 8 ? ALIVE_LEAF : DEAD_LEAF);
+}
+
+// Center of node advanced by 2^step_log2 generations, step_log2 <= level - 2
+// Node is split into 9 overlapping subsquares of level - 1. At full speed
+// (step_log2 == level - 2) both halves of the step are recursive successors,
+// for slower steps the first half just takes centers of subsquares
+uint32_t HashLife::successor(uint32_t id, int step_log2)
+{
+    Node n = _nodes[id];
+    if (n.population == 0)
+        return emptyNode(n.level - 1);
+    if (n.level == 2)
+        return baseSuccessor(id);
+
+    bool full = step_log2 == (int)n.level - 2;
+    uint64_t slow_key = ((uint64_t)id << 8) | (uint64_t)step_log2;
+    if (full)
+    {
+        if (n.result != NO_NODE) return n.result;
+    }
+    else
+    {
+        auto found = _slow_results.find(slow_key);
+        if (found != _slow_results.end()) return found->second;
+    }
+
+    uint32_t sub[9] = {
+        n.nw,                        horizontalCentre(n.nw, n.ne), n.ne,
+        verticalCentre(n.nw, n.sw),  centre(id),                   verticalCentre(n.ne, n.se),
+        n.sw,                        horizontalCentre(n.sw, n.se), n.se
+    };
+    for (int i = 0; i < 9; i++)
+        sub[i] = full ? successor(sub[i], step_log2 - 1) : centre(sub[i]);
+
+    int inner_step = full ? step_log2 - 1 : step_log2;
+    uint32_t res = join(
+        successor(join(sub[0], sub[1], sub[3], sub[4]), inner_step),
+        successor(join(sub[1], sub[2], sub[4], sub[5]), inner_step),
+        successor(join(sub[3], sub[4], sub[6], sub[7]), inner_step),
+        successor(join(sub[4], sub[5], sub[7], sub[8]), inner_step));
+
+    if (full) _nodes[id].result = res;
+    else      _slow_results[slow_key] = res;
+    return res;
+}
+
+// Advances universe by 2^step_log2 generations
+// Root is grown until the pattern cannot leave the result square:
+// live cells in the inner 1/16 of root and step_log2 <= level - 3,
+// so in 2^step_log2 <= size / 8 generations they stay inside the central quarter
+void HashLife::StepPow2(int step_log2)
+{
+    if (step_log2 < 0 || step_log2 > MAX_ROOT_LEVEL - 3)
+        throw std::invalid_argument("HashLife step is out of range");
+
+    if (_nodes.size() > _node_limit)
+        collectGarbage();
+
+    while ((int)_nodes[_root].level < step_log2 + 3 || !rootCentred())
+        expand();
+    _root = successor(_root, step_log2);
+    if (_nodes[_root].level < MIN_ROOT_LEVEL)
+        expand();
+    _generation += (uint64_t)1 << step_log2;
+}
+
+// Advances universe by given number of generations
+void HashLife::Step(uint64_t generations)
+{
+    for (int bit = 63; bit >= 0; bit--)
+        if ((generations >> bit) & 1)
+            StepPow2(bit);
+}
+
+// Drops nodes not reachable from root, memoized results of kept
+// nodes stay if they point to kept nodes
+void HashLife::collectGarbage()
+{
+    std::vector<uint32_t> remap(_nodes.size(), NO_NODE);
+    std::vector<Node> kept;
+    kept.reserve(_nodes.size() / 2);
+    kept.push_back(_nodes[DEAD_LEAF]);
+    kept.push_back(_nodes[ALIVE_LEAF]);
+    remap[DEAD_LEAF] = DEAD_LEAF;
+    remap[ALIVE_LEAF] = ALIVE_LEAF;
+
+    // Children get ids before parents: nodes are visited in post order
+    std::vector<std::pair<uint32_t, bool>> stack;
+    stack.push_back({ _root, false });
+    while (!stack.empty())
+    {
+        auto top = stack.back();
+        stack.pop_back();
+        uint32_t id = top.first;
+        if (remap[id] != NO_NODE) continue;
+        const Node& n = _nodes[id];
+        if (top.second)
+        {
+            remap[id] = (uint32_t)kept.size();
+            kept.push_back(Node{ remap[n.nw], remap[n.ne], remap[n.sw], remap[n.se],
+                                 n.result, n.level, n.population });
+            continue;
+        }
+        stack.push_back({ id, true });
+        stack.push_back({ n.nw, false });
+        stack.push_back({ n.ne, false });
+        stack.push_back({ n.sw, false });
+        stack.push_back({ n.se, false });
+    }
+    for (auto& n : kept)
+        if (n.result != NO_NODE)
+            n.result = remap[n.result];
+
+    _root = remap[_root];
+    _nodes.swap(kept);
+    size_t table_size = 1 << 16;
+    while (table_size < _nodes.size() * 2)
+        table_size *= 2;
+    _table.assign(table_size, NO_NODE);
+    _table_used = 0;
+    for (uint32_t id = 2; id < _nodes.size(); id++)
+        insertTable(id);
+    _empty.resize(1);
+    _slow_results.clear();
+}
+
+#pragma endregion
+
+#pragma region Cells
+
+// x, y are offsets inside node square
+uint32_t HashLife::setCell(uint32_t id, uint64_t x, uint64_t y, bool val)
+{
+    Node n = _nodes[id];
+    if (n.level == 0)
+        return val ? ALIVE_LEAF : DEAD_LEAF;
+    uint64_t half = (uint64_t)1 << (n.level - 1);
+    if (x < half)
+    {
+        if (y < half) return join(setCell(n.nw, x, y, val), n.ne, n.sw, n.se);
+        return join(n.nw, setCell(n.ne, x, y - half, val), n.sw, n.se);
+    }
+    if (y < half) return join(n.nw, n.ne, setCell(n.sw, x - half, y, val), n.se);
+    return join(n.nw, n.ne, n.sw, setCell(n.se, x - half, y - half, val));
+}
+
+void HashLife::SetCell(int64_t x, int64_t y, bool val)
+{
+    while (true)
+    {
+        int64_t half = (int64_t)1 << (_nodes[_root].level - 1);
+        if (x >= -half && x < half && y >= -half && y < half)
+        {
+            _root = setCell(_root, (uint64_t)(x + half), (uint64_t)(y + half), val);
+            return;
+        }
+        expand();
+    }
+}
+
+bool HashLife::GetCell(int64_t x, int64_t y)
+{
+    uint32_t level = _nodes[_root].level;
+    int64_t half = (int64_t)1 << (level - 1);
+    if (x < -half || x >= half || y < -half || y >= half)
+        return false;
+    uint64_t ux = (uint64_t)(x + half), uy = (uint64_t)(y + half);
+    uint32_t id = _root;
+    while (_nodes[id].level > 0)
+    {
+        const Node& n = _nodes[id];
+        uint64_t h = (uint64_t)1 << (n.level - 1);
+        if (ux < h) id = (uy < h) ? n.nw : n.ne;
+        else        id = (uy < h) ? n.sw : n.se;
+        ux &= h - 1;
+        uy &= h - 1;
+    }
+    return id == ALIVE_LEAF;
+}
+
+// x, y are coordinates of the top left cell of node
+void HashLife::forEachCell(uint32_t id, int64_t x, int64_t y,
+                           const std::function<void(int64_t, int64_t)>& visit)
+{
+    const Node& n = _nodes[id];
+    if (n.population == 0) return;
+    if (n.level == 0)
+    {
+        visit(x, y);
+        return;
+    }
+    int64_t half = (int64_t)1 << (n.level - 1);
+    uint32_t nw = n.nw, ne = n.ne, sw = n.sw, se = n.se;
+    forEachCell(nw, x, y, visit);
+    forEachCell(ne, x, y + half, visit);
+    forEachCell(sw, x + half, y, visit);
+    forEachCell(se, x + half, y + half, visit);
+}
+
+// Calls visit(x, y) for every live cell
+void HashLife::ForEachCell(const std::function<void(int64_t, int64_t)>& visit)
+{
+    int64_t half = (int64_t)1 << (_nodes[_root].level - 1);
+    forEachCell(_root, -half, -half, visit);
+}
+
+#pragma endregion
+
+uint64_t HashLife::GetGeneration()  { return _generation;              }
+uint64_t HashLife::GetPopulation()  { return _nodes[_root].population; }
+size_t HashLife::GetNodeCount()     { return _nodes.size();            }
+void HashLife::SetNodeLimit(size_t nodes) { _node_limit = nodes;       }
@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+/// <summary>
+/// HashLife engine over unbounded plane.
+/// Universe is a quadtree of canonical nodes: equal squares share one node,
+/// found through hash table of (nw, ne, sw, se) children.
+/// Every node of level k (2^k x 2^k cells) memoizes its center square
+/// after 2^(k-2) generations, so repeated patterns are computed once
+/// and big powers of two are reached in time logarithmic in generation.
+/// Works for any totalistic B/S rule without B0
+/// </summary>
+class HashLife
+{
+private:
+    // Quadtree node, leaves (level 0) are nodes 0 (dead) and 1 (alive)
+    typedef struct Node_s
+    {
+        uint32_t nw, ne, sw, se;
+        // Center after 2^(level-2) generations, NO_NODE if not computed
+        uint32_t result;
+        uint32_t level;
+        uint64_t population;
+    } Node;
+
+    std::vector<Node> _nodes;
+    // Open addressing table of node ids, canonical node lookup
+    std::vector<uint32_t> _table;
+    size_t _table_used = 0;
+    // Empty node of every level
+    std::vector<uint32_t> _empty;
+    // Results of steps slower than 2^(level-2), key is node id and step log2
+    std::unordered_map<uint64_t, uint32_t> _slow_results;
+    // Next state of center 2x2 of 4x4 square, indexed by 16 cell bits
+    uint8_t _base[1 << 16];
+
+    uint32_t _root;
+    uint64_t _generation = 0;
+    size_t _node_limit = (size_t)1 << 24;
+
+    uint32_t join(uint32_t nw, uint32_t ne, uint32_t sw, uint32_t se);
+    void insertTable(uint32_t id);
+    void growTable();
+    uint32_t emptyNode(uint32_t level);
+    // Root placed in the center of twice bigger empty square
+    void expand();
+    // True if live cells of root are inside the center of its center
+    bool rootCentred();
+
+    uint32_t centre(uint32_t id);
+    uint32_t horizontalCentre(uint32_t w, uint32_t e);
+    uint32_t verticalCentre(uint32_t n, uint32_t s);
+    // Center of node advanced by 2^step_log2 generations,
+    // step_log2 <= level - 2
+    uint32_t successor(uint32_t id, int step_log2);
+    uint32_t baseSuccessor(uint32_t id);
+
+    uint32_t setCell(uint32_t id, uint64_t x, uint64_t y, bool val);
+    void forEachCell(uint32_t id, int64_t x, int64_t y,
+                     const std::function<void(int64_t, int64_t)>& visit);
+    // Drops nodes not reachable from root
+    void collectGarbage();
+
+public:
+    // b_mask/s_mask: bit k is set if k neighbours give birth/survival
+    // Throws std::invalid_argument for B0 rules
+    HashLife(uint16_t b_mask, uint16_t s_mask);
+    // Changes rule, cells of universe are kept
+    void SetRule(uint16_t b_mask, uint16_t s_mask);
+
+    // Cell (x, y): x is row, y is column, any 64-bit coordinates
+    // far enough from 2^62
+    void SetCell(int64_t x, int64_t y, bool val);
+    bool GetCell(int64_t x, int64_t y);
+    void Clear();
+
+    // Advances universe by given number of generations,
+    // one power of two step for every set bit
+    void Step(uint64_t generations);
+    // Advances universe by 2^step_log2 generations
+    void StepPow2(int step_log2);
+
+    uint64_t GetGeneration();
+    uint64_t GetPopulation();
+    size_t GetNodeCount();
+    // Garbage collection starts between steps when node count exceeds limit
+    void SetNodeLimit(size_t nodes);
+
+    // Calls visit(x, y) for every live cell
+    void ForEachCell(const std::function<void(int64_t, int64_t)>& visit);
+};
@@ -1,24 +1,47 @@
+#include "Life.h"
+#include "MappedFile.h"
+#include "Checkpoint.h"
+#include "CycleDetector.h"
+#include "SoupSearch.h"
+#include "ConsoleInput.h"
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <algorithm>
 #include <queue>
+#include <cstdlib>
+#include <cstring>
+#include <charconv>
+#include <string_view>
+#include <chrono>
+#include <atomic>
+#include <thread>
 #ifdef _WIN32
 #include <windows.h>
-#define CLEAR_SCREEN system("cls");
+#include <malloc.h>
 #else
 #include <unistd.h>
-#define CLEAR_SCREEN system("clear");
 #endif
 
 #define ACTIVE_CELL_CHAR '#'
 #define DEAD_CELL_CHAR ' '
 #define END_OF_FIELD_CHAR '|'
 
-#define SLEEP_TIME_MS 40
 #define DEFAULT_FIELD_SIZE 30,60
 
+// Tile of tiled schedule: TILE_ROWS rows by TILE_WORDS packed words
+#define TILE_ROWS 64
+#define TILE_WORDS 8
+
+// Rows between row written by kernel and row summarized in band tick
+#define SUMMARY_LAG 4
+// Dump output is formatted into buffer of this size and written in one call
+#define DUMP_BUFFER_SIZE (1 << 20)
+
+// Alignment of packed field buffer and of every row in it (bytes)
+#define FIELD_ALIGNMENT 64
+#define FIELD_ALIGNMENT_WORDS (FIELD_ALIGNMENT / sizeof(uint64_t))
 
 // Cross-platform sleep function
 void sleepcp(int milliseconds)
@@ -26,7 +49,30 @@ void sleepcp(int milliseconds)
 #ifdef _WIN32
     Sleep(milliseconds);
 #else
-    usleep(milliseconds * 10000);
+    usleep(milliseconds * 1000);
+#endif
+}
+
+// Cross-platform aligned allocation
+// size must be a multiple of alignment
+void* alignedAlloccp(size_t alignment, size_t size)
+{
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, alignment, size) != 0)
+        return nullptr;
+    return ptr;
+#endif
+}
+
+void alignedFreecp(void* ptr)
+{
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
 #endif
 }
 
@@ -39,670 +85,2327 @@ std::string getword(std::string line)
     return line.substr(0, line.find(" "));
 }
 
-/// <summary>
-///  Field class, contains information about cells.
-///  Supports get, set by coords(x,y) and draw field in console
-/// </summary>
-class Field 
+// Bit mask of digits in B/S integer: bit k is set if k is a digit
+// Digits are taken while remaining number is positive, so 0 can't be first
+uint16_t digitMask(int digits)
 {
-private:
-    bool** _field;
-    int n, m;
-
-    // Initialize field NxM
-    void createField(int _n, int _m)
+    uint16_t mask = 0;
+    while (digits > 0)
     {
-        this->n = _n;
-        this->m = _m;
-        _field = new bool* [_n];
-        for (int i = 0; i < _n; i++)
-            _field[i] = new bool[_m];
+        int d = digits % 10;
+        if (d <= 8) mask |= (uint16_t)(1 << d);
+        digits /= 10;
     }
+    return mask;
+}
 
-public:
-#pragma region Constructors
-
-    // Default field
-    Field()
-    {
-        createField(10, 10);
-    }
-    // Field with size = NxM
-    Field(int _n, int _m)
+// Bit mask of digits in B/S string, any digit may be 0
+// Returns false if string has other characters or digit 9
+bool digitMask(std::string digits, uint16_t* mask)
+{
+    uint16_t res = 0;
+    for (char c : digits)
     {
-        createField(_n, _m);
+        if (c < '0' || c > '8') return false;
+        res |= (uint16_t)(1 << (c - '0'));
     }
+    *mask = res;
+    return true;
+}
 
-#pragma endregion
+// Digits of mask in ascending order, e.g. B3/S23 masks => "3" and "23"
+std::string maskDigits(uint16_t mask)
+{
+    std::string digits;
+    for (int k = 0; k <= 8; k++)
+        if (mask & (1 << k)) digits += (char)('0' + k);
+    return digits;
+}
 
-    void DefaultPreset()
-    {
-        Clear();
+#pragma region Field
 
-        setAt(3, 2, true);
-        setAt(4, 3, true);
-        setAt(2, 4, true);
-        setAt(3, 4, true);
-        setAt(4, 4, true);
-    }
+// Cell buffers allocated by all fields
+static std::atomic<uint64_t> field_allocations(0);
 
-    void Clear()
-    {
-        for (int i = 0; i < this->n; i++)
-            for (int j = 0; j < this->m; j++)
-                _field[i][j] = false;
-    }
+// Initialize field NxM
+void Field::createField(int _n, int _m)
+{
+    if (_n <= 0 || _m <= 0)
+        throw std::invalid_argument("Field size must be positive");
+
+    this->n = _n;
+    this->m = _m;
+    _row_words = ((size_t)_m + 63) / 64;
+    _stride = (_row_words + FIELD_ALIGNMENT_WORDS - 1)
+            / FIELD_ALIGNMENT_WORDS * FIELD_ALIGNMENT_WORDS;
+
+    size_t bytes = (size_t)_n * _stride * sizeof(uint64_t);
+    _words = (uint64_t*)alignedAlloccp(FIELD_ALIGNMENT, bytes);
+    if (_words == nullptr) throw std::bad_alloc();
+    field_allocations++;
+    std::memset(_words, 0, bytes);
+}
 
-    void Draw()
-    {
-        for (int i = 0; i < this->n; i++)
-        {
-            for (int j = 0; j < this->m; j++)
-                std::cout << (getAt(i,j) ? ACTIVE_CELL_CHAR : DEAD_CELL_CHAR);
-            std::cout << END_OF_FIELD_CHAR << std::endl;
-        }
+void Field::freeField()
+{
+    alignedFreecp(_words);
+    _words = nullptr;
+}
+
+// Default field
+Field::Field()
+{
+    createField(10, 10);
+}
+// Field with size = NxM
+Field::Field(int _n, int _m)
+{
+    createField(_n, _m);
+}
+
+Field::Field(const Field& other)
+{
+    createField(other.n, other.m);
+    std::memcpy(_words, other._words, (size_t)n * _stride * sizeof(uint64_t));
+}
 
+Field& Field::operator=(const Field& other)
+{
+    if (this == &other) return *this;
+    if (n != other.n || m != other.m)
+    {
+        freeField();
+        createField(other.n, other.m);
     }
+    std::memcpy(_words, other._words, (size_t)n * _stride * sizeof(uint64_t));
+    _version++;
+    return *this;
+}
 
-#pragma region IndexationUtils
+Field::~Field()
+{
+    freeField();
+}
+
+// Exchanges cells with other field of the same size
+// Only buffers are exchanged, no cells are copied
+void Field::Swap(Field& other)
+{
+    if (n != other.n || m != other.m)
+        throw std::invalid_argument("Swapped fields must have the same size");
+    std::swap(_words, other._words);
+    _version++;
+    other._version++;
+}
 
-    // Block of utility functions for
-    // array indexation
+void Field::DefaultPreset()
+{
+    Clear();
 
-    // Normalization provides closure of field
-    // e.g. (x = -1) => (x = N)
-    //      (x =  N) => (x = 0)
-    // Same for y
+    setAt(3, 2, true);
+    setAt(4, 3, true);
+    setAt(2, 4, true);
+    setAt(3, 4, true);
+    setAt(4, 4, true);
+}
 
-    int getN()        { return this->n; }
-    int getM()        { return this->m; }
-    int normalizeX(int x, bool is_y = false) 
+// Changes size to NxM, all cells are cleared
+void Field::Resize(int n, int m)
+{
+    if (n != this->n || m != this->m)
     {
-        int border = this->n;
-        if (is_y) border = this->m;
+        freeField();
+        createField(n, m);
+        _version++;
+    }
+    else Clear();
+}
+
+void Field::Clear()
+{
+    std::memset(_words, 0, (size_t)n * _stride * sizeof(uint64_t));
+    _version++;
+}
 
-        int res = x - border * (int)(x / border);
-        if (res < 0) res += border;
-        return res;
+// Rows are built in one string and printed at once
+void Field::Draw()
+{
+    std::string rows;
+    rows.reserve((size_t)n * (m + 2));
+    for (int i = 0; i < this->n; i++)
+    {
+        for (int j = 0; j < this->m; j++)
+            rows += getAt(i, j) ? ACTIVE_CELL_CHAR : DEAD_CELL_CHAR;
+        rows += END_OF_FIELD_CHAR;
+        rows += '\n';
     }
-    int normalizeY(int y) { return normalizeX(y, true); }
-    bool getAt(int x, int y) { return this->_field[normalizeX(x)][normalizeY(y)]; }
-    void setAt(int x, int y, bool val) { this->_field[normalizeX(x)][normalizeY(y)] = val; }
-    //bool** getField() { return _field; }
+    std::cout << rows << std::flush;
+}
 
-#pragma endregion
-};
+int Field::getN()        { return this->n; }
+int Field::getM()        { return this->m; }
+int Field::normalizeX(int x, bool is_y)
+{
+    int border = this->n;
+    if (is_y) border = this->m;
 
-// Struct that represents cell operation
-// Means: "set <val> at <x,y>"
-typedef struct CellOp_s
+    int res = x - border * (int)(x / border);
+    if (res < 0) res += border;
+    return res;
+}
+int Field::normalizeY(int y) { return normalizeX(y, true); }
+bool Field::getAt(int x, int y)
 {
-    int x, y;
-    bool val;
-} CellOp;
+    x = normalizeX(x);
+    y = normalizeY(y);
+    return (getRow(x)[y >> 6] >> (y & 63)) & 1;
+}
+void Field::setAt(int x, int y, bool val)
+{
+    x = normalizeX(x);
+    y = normalizeY(y);
+    uint64_t bit = (uint64_t)1 << (y & 63);
+    if (val) getRow(x)[y >> 6] |=  bit;
+    else     getRow(x)[y >> 6] &= ~bit;
+    _version++;
+}
 
-/// <summary>
-/// This class is used as a part of the logic
-/// to read and parse files with presets
-/// </summary>
-class PresetParser
+size_t Field::getRowWords()   { return _row_words; }
+size_t Field::getStride()     { return _stride;    }
+uint64_t* Field::getRow(int x) { return _words + (size_t)x * _stride; }
+uint64_t Field::getVersion()   { return _version;   }
+void Field::markModified()     { _version++;        }
+uint64_t Field::GetAllocations() { return field_allocations; }
+bool Field::Equals(Field& other)
+{
+    if (n != other.n || m != other.m) return false;
+    for (int x = 0; x < n; x++)
+        if (std::memcmp(getRow(x), other.getRow(x), _row_words * sizeof(uint64_t)) != 0)
+            return false;
+    return true;
+}
+uint64_t Field::getLastWordMask()
 {
+    int used = m & 63;
+    return used == 0 ? ~(uint64_t)0 : ((uint64_t)1 << used) - 1;
+}
 
-private:
-    std::string _inputFile;
+#pragma endregion
 
-    std::string _presetName = std::string("Default loaded preset");
-    std::string _presetComment = std::string("...");
-    int b = 3, s = 23;
-    bool parsed = false;
+#pragma region PresetParser
 
-    // Choosing a parser for parameter string
-    // marked with # at the beginning of the line
-    // Returns true if parameter is recognized and parsed
-    // false - otherwise
-    bool parseParameter(std::string line)
+// Choosing a parser for parameter string
+// marked with # at the beginning of the line
+// Returns true if parameter is recognized and parsed
+// false - otherwise
+bool PresetParser::parseParameter(std::string line)
+{
+    switch (line[1])
     {
-        switch (line[1])
-        {
-        case 'R':
-            return parseR(line);
-            break;
-        case 'N':
-            return parseN(line);
-            break;
-        }
-        return false;
+    case 'R':
+        return parseR(line);
+        break;
+    case 'N':
+        return parseN(line);
+        break;
     }
+    return false;
+}
 
-    // Parser for R parameter
-    bool parseR(std::string line)
-    {
-#ifdef _WIN32
-        int ret = sscanf_s(line.c_str(), "#R B%d/S%d", &b, &s);
-#else
-        int ret = sscanf(line.c_str(), "#R B%d/S%d", &b, &s);
-#endif
-        return ret == 2;
-    }
-    // Parser for N parameter
-    bool parseN(std::string line)
+// Parser for R parameter
+// Rule is kept as digit masks, so B0 and empty digit lists are allowed
+bool PresetParser::parseR(std::string line)
+{
+    if (line.compare(0, 4, "#R B") != 0) return false;
+    return parseRule(line.substr(3));
+}
+// Sets rule from "B3/S23" or "23/3" (S/B) notation
+bool PresetParser::parseRule(std::string rule)
+{
+    rule = rule.substr(0, rule.find_first_of(" \t\r,"));
+    size_t slash = rule.find('/');
+    if (slash == std::string::npos) return false;
+    std::string first = rule.substr(0, slash), second = rule.substr(slash + 1);
+
+    std::string b_digits, s_digits;
+    if (!first.empty() && (first[0] == 'B' || first[0] == 'b')
+        && !second.empty() && (second[0] == 'S' || second[0] == 's'))
     {
-        _presetComment = line.substr(3);
-        return _presetComment.size() > 0;
+        b_digits = first.substr(1);
+        s_digits = second.substr(1);
     }
-    // Parser for active cell
-    bool parseCell(std::string line, std::queue<CellOp*>* ops_q)
+    else
     {
-        int x, y;
-        std::stringstream  linestream(line);
-        linestream >> x >> y;
-        if (!linestream) return false;
-        CellOp* op = new CellOp;
-        op->x = x;
-        op->y = y;
-        op->val = true;
-        ops_q->push(op);
-        return true;
+        s_digits = first;
+        b_digits = second;
     }
+    uint16_t b_mask, s_mask;
+    if (!digitMask(b_digits, &b_mask) || !digitMask(s_digits, &s_mask))
+        return false;
 
-public:
-    PresetParser(char* str)       { _inputFile = std::string(str); }
-    PresetParser(std::string str) { _inputFile = str;              }
-    void SetFile(char* str)       { _inputFile = std::string(str); }
-    void SetFile(std::string str) { _inputFile = str;              }
+    _b_mask = b_mask;
+    _s_mask = s_mask;
+    // Integers come from masks, repeated digits like B333333333333 would overflow
+    b_digits = maskDigits(b_mask);
+    s_digits = maskDigits(s_mask);
+    b = b_digits.empty() ? 0 : std::stoi(b_digits);
+    s = s_digits.empty() ? 0 : std::stoi(s_digits);
+    return true;
+}
+// Parser for N parameter
+bool PresetParser::parseN(std::string line)
+{
+    _presetComment = line.substr(3);
+    return _presetComment.size() > 0;
+}
+// Parser for active cell line [begin, end), "<x> <y>"
+// Integers are read in place by from_chars, text after y is ignored
+bool PresetParser::parseCell(const char* begin, const char* end, int* x, int* y)
+{
+    const char* p = begin;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    std::from_chars_result res = std::from_chars(p, end, *x);
+    if (res.ec != std::errc() || res.ptr == end || (*res.ptr != ' ' && *res.ptr != '\t'))
+        return false;
+    p = res.ptr;
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    res = std::from_chars(p, end, *y);
+    return res.ec == std::errc();
+}
 
-    // Start parsing file
-    // Filling queue with operations, allowing Logic class
-    // to restore world from preset in file
-    // Also sets preset paremeters such as name, comment and B/S
-    // Note that this parameters are stored inside this class
-    // and needs to be read separately from queue
-    void Parse(std::queue<CellOp*>* ops_q)
-    {
-        std::ifstream infile(_inputFile);
-        if (!infile) throw std::invalid_argument("Input file not found");
-        std::string line;
-        int count = 0;
+PresetParser::PresetParser(char* str)       { _inputFile = std::string(str); }
+PresetParser::PresetParser(std::string str) { _inputFile = str;              }
+void PresetParser::SetFile(char* str)       { _inputFile = std::string(str); }
+void PresetParser::SetFile(std::string str) { _inputFile = str;              }
 
-        // First line is a name
-        std::getline(infile, _presetName);
+static bool hasExtension(const std::string& file, const char* ext)
+{
+    size_t length = std::strlen(ext);
+    return file.size() >= length && file.compare(file.size() - length, length, ext) == 0;
+}
 
-        while (std::getline(infile, line)) {
-            count++;
-            bool result;
-            if (line[0] == '#') result = parseParameter(line);
-            else                result = parseCell(line, ops_q);
-            if (!result) std::cout << "[Line " << count << "] " 
-                                   << "Failed to parse: " << line << std::endl;
-        }
+static bool isLife106File(const std::string& file)
+{
+    return hasExtension(file, ".lif") || hasExtension(file, ".life");
+}
 
-        parsed = true;
-    }
-    void Dump(std::queue<CellOp*>* ops_q, std::string output)
-    {
-        std::ofstream fout;
-        fout.open(output);
-        fout << _presetName << std::endl;
-        fout << "#N " << _presetComment << std::endl;
-        fout << "#R B" << b << "/S" << s << std::endl;
-        for (; !ops_q->empty(); ops_q->pop())
-        {
-            CellOp* op = ops_q->front();
-            fout << op->x << " " << op->y << std::endl;
-            delete op;
-        }
-    }
+// Next line of [p, end) without line break, p is moved past it
+static std::string_view nextLine(const char*& p, const char* end)
+{
+    const char* eol = (const char*)std::memchr(p, '\n', end - p);
+    if (eol == nullptr) eol = end;
+    const char* line_end = eol;
+    if (line_end > p && line_end[-1] == '\r') line_end--;
+    std::string_view line(p, line_end - p);
+    p = eol < end ? eol + 1 : end;
+    return line;
+}
 
-    int GetB() { return b; }
-    int GetS() { return s; }
+static void printParseFailure(int line_number, std::string_view line)
+{
+    std::cout << "[Line " << line_number << "] "
+              << "Failed to parse: " << line << std::endl;
+}
 
-    std::string GetComment() { return _presetComment; }
-    std::string GetName()    { return _presetName;    }
-};
+// Format of file by extension, or by contents [data, data + size)
+// RLE header is the first line not starting with '#',
+// plaintext starts with '!' comment or a row of '.' and 'O',
+// Life 1.06 starts with "#Life 1.06" header
+PresetFormat PresetParser::detectFormat(const char* data, size_t size)
+{
+    if (isSnapshot(data, size))               return FORMAT_SNAPSHOT;
+    if (hasExtension(_inputFile, ".rle"))     return FORMAT_RLE;
+    if (hasExtension(_inputFile, ".cells"))   return FORMAT_PLAINTEXT;
+    if (isLife106File(_inputFile))            return FORMAT_LIFE106;
+
+    const char* p = data;
+    const char* end = data + size;
+    if (p < end && *p == '!') return FORMAT_PLAINTEXT;
+    if (size >= 10 && std::memcmp(p, "#Life 1.06", 10) == 0) return FORMAT_LIFE106;
+    while (p < end)
+    {
+        std::string_view line = nextLine(p, end);
+        if (!line.empty() && line[0] == '#') continue;
+        size_t eq = line.find('=');
+        if (!line.empty() && line[0] == 'x' && eq != std::string_view::npos
+            && line.find_first_not_of(" \t", 1) == eq)
+            return FORMAT_RLE;
+        if (!line.empty() && line.find_first_not_of(".O") == std::string_view::npos)
+            return FORMAT_PLAINTEXT;
+        break;
+    }
+    return FORMAT_NATIVE;
+}
 
-/// <summary>
-/// Performs all operations over cells and updates state
-/// of the game by Tick()
-/// </summary>
-class Logic 
+// Name line, then parameter and cell lines
+template <class CellVisitor>
+void PresetParser::parseNative(const char* p, const char* end, CellVisitor& visit)
 {
-private:
-    Field* _field_ptr;
-    std::queue<CellOp*> ops_q;
-    int b, s;
-    std::vector<std::string> load_messages;
+    // First line is a name
+    if (p < end) _presetName = std::string(nextLine(p, end));
+    int count = 0;
+    while (p < end)
+    {
+        std::string_view line = nextLine(p, end);
+        count++;
+        bool result;
+        int x, y;
+        if (!line.empty() && line[0] == '#')
+            result = parseParameter(std::string(line));
+        else if ((result = parseCell(line.data(), line.data() + line.size(), &x, &y)))
+            visit(x, y);
+        if (!result) printParseFailure(count, line);
+    }
+}
 
-    // Sum of active neighbours for cell at (x,y)
-    int activeCellSum(int x, int y)
+// "#Life 1.06" header, '#' lines, then "<x> <y>" cell lines
+// First two #D lines are name and comment, #N is B3/S23 rule, #R is rule
+// Life 1.06 x is column, so Life 1.06 (x, y) is cell (y, x)
+template <class CellVisitor>
+void PresetParser::parseLife106(const char* p, const char* end, CellVisitor& visit)
+{
+    int count = 0, descriptions = 0;
+    while (p < end)
     {
-        int sum = 0;
-        for (int i = x - 1; i <= x + 1; i++)
+        std::string_view line = nextLine(p, end);
+        count++;
+        if (line.empty()) continue;
+        bool result = true;
+        int x, y;
+        if (line[0] == '#')
         {
-            for (int j = y - 1; j <= y + 1; j++)
+            std::string text = line.size() > 3 ? std::string(line.substr(3)) : std::string();
+            if (line.size() > 1 && line[1] == 'D')
             {
-                if (i == x && j == y) continue;
-                sum += (_field_ptr->getAt(i, j)) ? 1 : 0;
+                if (descriptions == 0) _presetName = text;
+                else if (descriptions == 1) _presetComment = text;
+                descriptions++;
             }
+            else if (line.size() > 1 && line[1] == 'N')
+                result = parseRule("B3/S23");
+            else if (line.size() > 1 && line[1] == 'R')
+                result = parseRule(text);
+            // Header and other lines of Life 1.05 are skipped
         }
-        return sum;
+        else if ((result = parseCell(line.data(), line.data() + line.size(), &x, &y)))
+            visit(y, x);
+        if (!result) printParseFailure(count, line);
     }
-    // Check sum of neighbour active cells for birth
-    // If s == true, it checks S (survival) instead
-    // For S better use checkS(sum)
-    bool checkB(int sum, bool check_s = false)
-    {
-        int _b = b;
-        if (check_s) _b = s;
+}
 
-        while (_b > 0)
+// "#N name", "#C comment" lines, header "x = m, y = n, rule = B3/S23",
+// then runs "<count><tag>": b - dead cells, o - live cells, $ - end of row,
+// ! - end of pattern. RLE x is column, so RLE (x, y) is cell (y, x)
+template <class CellVisitor>
+void PresetParser::parseRle(const char* p, const char* end, CellVisitor& visit)
+{
+    int count = 0;
+    bool header = false, comment = false;
+    int x = 0, y = 0;
+    while (p < end)
+    {
+        std::string_view line = nextLine(p, end);
+        count++;
+        if (!header)
         {
-            if (_b % 10 == sum)
-                return true;
-            _b /= 10;
+            if (line.empty()) continue;
+            if (line[0] == '#')
+            {
+                if (line.size() > 3 && line[1] == 'N')
+                    _presetName = std::string(line.substr(3));
+                else if (line.size() > 3 && (line[1] == 'C' || line[1] == 'c') && !comment)
+                {
+                    _presetComment = std::string(line.substr(3));
+                    comment = true;
+                }
+                else if (line.size() > 3 && line[1] == 'r')
+                    parseRule(std::string(line.substr(3)));
+                continue;
+            }
+            header = true;
+            size_t rule = line.find("rule");
+            if (rule != std::string_view::npos)
+            {
+                size_t eq = line.find('=', rule);
+                size_t from = line.find_first_not_of(" \t", eq + 1);
+                if (eq == std::string_view::npos || from == std::string_view::npos
+                    || !parseRule(std::string(line.substr(from))))
+                    printParseFailure(count, line);
+            }
+            continue;
         }
 
-        return false;
-    }
-    // Check sum of neighbour active cells for survival
-    bool checkS(int sum)
-    {
-        return checkB(sum, true);
-    }
-    // Push new cell operation into queue
-    void pushOp(int x, int y, bool val)
-    {
-        CellOp* op = new CellOp;
-        op->x = x;
-        op->y = y;
-        op->val = val;
-        ops_q.push(op);
-    }
-    // Scans entire field and build operation queue
-    // that can transform field to next iteration
-    void scanField()
-    {
-        for (int i = 0; i < _field_ptr->getN(); i++)
+        long long run = 0;
+        for (size_t i = 0; i < line.size(); i++)
         {
-            for (int j = 0; j < _field_ptr->getM(); j++)
+            char c = line[i];
+            if (c >= '0' && c <= '9')
             {
-                int cellSum  = activeCellSum(i,j);
-                bool alive   = _field_ptr->getAt(i, j);
-                bool birth   = checkB(cellSum);
-                bool survive = checkS(cellSum);
-
-                bool newState = (alive && survive) || birth;
-                if (newState != alive) pushOp(i, j, newState);
+                run = run * 10 + (c - '0');
+                if (run > INT32_MAX)
+                {
+                    printParseFailure(count, line);
+                    return;
+                }
+                continue;
+            }
+            int n = run > 0 ? (int)run : 1;
+            run = 0;
+            if (c == ' ' || c == '\t') continue;
+            if (c == '!') return;
+            if (c == '$') { x += n; y = 0; }
+            else if (c == 'b' || c == '.') y += n;
+            else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            {
+                // Any other state of multi-state RLE is alive
+                for (int k = 0; k < n; k++) visit(x, y + k);
+                y += n;
+            }
+            else
+            {
+                printParseFailure(count, line);
+                break;
             }
         }
     }
-    // Applies cell operations listed in ops_q
-    // and updates field
-    void applyCellOpsQueue()
+}
+
+// "!Name: name" and other '!' comment lines, then rows of '.' (dead) and 'O' (alive)
+template <class CellVisitor>
+void PresetParser::parsePlaintext(const char* p, const char* end, CellVisitor& visit)
+{
+    int count = 0, x = 0;
+    bool comment = false;
+    while (p < end)
     {
-        for (; !ops_q.empty() > 0; ops_q.pop())
+        std::string_view line = nextLine(p, end);
+        count++;
+        if (!line.empty() && line[0] == '!')
         {
-            CellOp* op = ops_q.front();
-            if (_field_ptr->getAt(op->x, op->y) == op->val)
+            if (line.compare(0, 7, "!Name: ") == 0)
+                _presetName = std::string(line.substr(7));
+            else if (!comment)
             {
-                std::ostringstream oss;
-                oss << "[Note] Overlaping coordinats on input: (" << op->x << ", " << op->y << ")";
-                load_messages.push_back(oss.str());
+                _presetComment = std::string(line.substr(1));
+                comment = true;
             }
-            _field_ptr->setAt(op->x, op->y, op->val);
-            delete op;
+            continue;
         }
-    }
-
-    // For debug. Prints map of active neighbours
-    void printCellSums()
-    {
-        for (int i = 0; i < _field_ptr->getN(); i++)
+        for (size_t y = 0; y < line.size(); y++)
         {
-            for (int j = 0; j < _field_ptr->getM(); j++)
-                std::cout << activeCellSum(i, j);
-            std::cout << std::endl;
+            if (line[y] == 'O' || line[y] == '*') visit(x, (int)y);
+            else if (line[y] != '.')
+            {
+                printParseFailure(count, line);
+                break;
+            }
         }
+        x++;
     }
+}
 
-public:
-    // Default logic B3/S23
-    Logic(Field* field)
-    {
-        b = 3;
-        s = 23;
-        _field_ptr = field;
-    }
-    // Logic with Bb/Ss parameters
-    // B and S are represented as integer
-    // e.g. B123 => b = 123
-    //      B45  => b = 45
-    //      S140 => s = 140
-    // WARNING: 0 in B/S parameters must NOT be first digit
-    // Multiple same digits are counted as one: 1223 = 123
-    Logic(Field* field, int b, int s)
-    {
-        this->b = b;
-        this->s = s;
-        _field_ptr = field;
-    }
-    void SetField(Field* field)
-    {
-        _field_ptr = field;
-    }
-    Field* GetField()
+// File is scanned in place, only parameter lines are copied
+template <class CellVisitor>
+void PresetParser::parseMapped(CellVisitor visit)
+{
+    MappedFile file(_inputFile);
+    const char* p = file.Data();
+    const char* end = p + file.Size();
+    switch (detectFormat(p, file.Size()))
     {
-        return _field_ptr;
+    case FORMAT_RLE:
+        parseRle(p, end, visit);
+        break;
+    case FORMAT_PLAINTEXT:
+        parsePlaintext(p, end, visit);
+        break;
+    case FORMAT_LIFE106:
+        parseLife106(p, end, visit);
+        break;
+    default:
+        parseNative(p, end, visit);
+        break;
     }
-    void Tick()
+    parsed = true;
+}
+
+// Start parsing file
+// Filling queue with operations, allowing Logic class
+// to restore world from preset in file
+// Also sets preset paremeters such as name, comment and B/S
+// Note that this parameters are stored inside this class
+// and needs to be read separately from queue
+void PresetParser::Parse(std::queue<CellOp*>* ops_q)
+{
+    if (IsSnapshot())
     {
-        scanField();
-        applyCellOpsQueue();
+        Field field;
+        LoadSnapshot(&field);
+        Logic(&field).FillQueueWithCurrentState(ops_q);
+        return;
     }
-    void DrawField() { _field_ptr->Draw(); }
-    int GetFieldHeight() { return _field_ptr->getN(); }
-    int GetFieldWidth() { return _field_ptr->getM(); }
+    parseMapped([ops_q](int x, int y) {
+        ops_q->push(new CellOp{ x, y, true });
+    });
+}
 
-    void LoadPreset(PresetParser* prepar)
+// Snapshot cells are read from its packed rows
+template <class CellVisitor>
+void PresetParser::ForEachCell(CellVisitor visit)
+{
+    if (!IsSnapshot())
     {
-        _field_ptr->Clear();
-        prepar->Parse(&ops_q);
-        this->b = prepar->GetB();
-        this->s = prepar->GetS();
-        applyCellOpsQueue();
+        parseMapped(visit);
+        return;
     }
-    void LoadDefault()
+    Field field;
+    LoadSnapshot(&field);
+    size_t words = field.getRowWords();
+    for (int x = 0; x < field.getN(); x++)
     {
-        _field_ptr->Clear();
-        _field_ptr->DefaultPreset();
+        const uint64_t* row = field.getRow(x);
+        for (size_t w = 0; w < words; w++)
+            for (uint64_t bits = row[w]; bits; bits &= bits - 1)
+                visit(x, (int)(w * 64 + lowestBit(bits)));
     }
+}
 
-    void FillQueueWithCurrentState(std::queue<CellOp*>* ops_q)
+// Same as Parse, but active cells are set straight into field
+// Returns number of cells listed more than once
+long long PresetParser::Load(Field* field)
+{
+    if (IsSnapshot())
     {
-        for (int i = 0; i < _field_ptr->getN(); i++)
-        {
-            for (int j = 0; j < _field_ptr->getM(); j++)
-            {
-                if (_field_ptr->getAt(i, j))
-                    ops_q->push(new CellOp{ i, j, true });
-            }
-        }
+        LoadSnapshot(field);
+        return 0;
     }
+    long long overlaps = 0;
+    parseMapped([field, &overlaps](int x, int y) {
+        if (field->getAt(x, y)) overlaps++;
+        field->setAt(x, y, true);
+    });
+    return overlaps;
+}
 
-    void PrintMessages()
-    {
-        for (auto iter = load_messages.begin(); iter != load_messages.end(); iter++)
-        {
-            std::cout << *iter << std::endl;
-        }
+PresetFormat PresetParser::GetFormat()
+{
+    MappedFile file(_inputFile);
+    return detectFormat(file.Data(), file.Size());
+}
 
-        load_messages.clear();
-    }
-};
+// True if input file is binary snapshot (see Snapshot.h)
+bool PresetParser::IsSnapshot()
+{
+    char magic[SNAPSHOT_MAGIC_SIZE];
+    std::ifstream infile(_inputFile, std::ios::binary);
+    if (!infile.read(magic, SNAPSHOT_MAGIC_SIZE)) return false;
+    return isSnapshot(magic, SNAPSHOT_MAGIC_SIZE);
+}
 
-// Struct for ModeSelector class
-// Contains passed parameters from UserInterfaceWrap class
-typedef struct ModeContext_s
+// Loads snapshot with its parameters, field is resized to snapshot size
+void PresetParser::LoadSnapshot(Field* field)
 {
-    Logic** logic;
-    PresetParser** prepar;
-    std::string inputFile;
-    std::string outputFile;
-    int offline_ticks;
-} ModeContext;
+    MappedFile file(_inputFile);
+    SnapshotHeader header = readSnapshot(file.Data(), file.Size(), field);
+    _presetName = header.name;
+    _presetComment = header.comment;
+    _b_mask = header.b_mask & 0x1FF;
+    _s_mask = header.s_mask & 0x1FF;
+    std::string b_digits = maskDigits(_b_mask), s_digits = maskDigits(_s_mask);
+    b = b_digits.empty() ? 0 : std::stoi(b_digits);
+    s = s_digits.empty() ? 0 : std::stoi(s_digits);
+    _generation = header.generation;
+    parsed = true;
+}
 
-// Strategy abstract class for selecting different app mode
-class ModeSelector
+void PresetParser::SaveSnapshot(Field* field, std::string output, uint64_t generation, bool compress)
 {
-public:
-    virtual void ConfigLogic(ModeContext context) = 0;
-};
+    SnapshotHeader header;
+    header.flags = compress ? SNAPSHOT_FLAG_COMPRESSED : 0;
+    header.b_mask = _b_mask;
+    header.s_mask = _s_mask;
+    header.generation = generation;
+    header.name = _presetName;
+    header.comment = _presetComment;
+    std::ofstream fout(output, std::ios::binary);
+    writeSnapshot(fout, header, field);
+}
 
-// Default mode, loading default map preset
-// Ignores input file
-// Sets default prepar
-class DefaultMode : public ModeSelector
+// Saves field in format chosen by extension of output
+void PresetParser::Save(Field* field, std::string output, uint64_t generation)
 {
-private:
+    if (hasExtension(output, SNAPSHOT_EXTENSION))  SaveSnapshot(field, output, generation);
+    else if (hasExtension(output, ".rle"))         DumpRle(field, output);
+    else if (hasExtension(output, ".cells"))       DumpPlaintext(field, output);
+    else                                           Dump(field, output);
+}
 
-public:
-    virtual void ConfigLogic(ModeContext context)
+// Writes name, comment and B/S lines of dump
+// Life 1.06 keeps name and comment in #D lines after "#Life 1.06" header
+void PresetParser::dumpHeader(std::ostream& out, bool life106)
+{
+    if (life106)
     {
-        Field* f = new Field(DEFAULT_FIELD_SIZE);
-        Logic* l = new Logic(f, 3, 23);
-        l->LoadDefault();
-        *(context.logic) = l;
-        *(context.prepar) = new PresetParser("");
+        out << "#Life 1.06\n";
+        out << "#D " << _presetName << '\n';
+        out << "#D " << _presetComment << '\n';
     }
-};
+    else
+    {
+        out << _presetName << '\n';
+        out << "#N " << _presetComment << '\n';
+    }
+    out << "#R B" << maskDigits(_b_mask) << "/S" << maskDigits(_s_mask) << '\n';
+}
 
-// Mode with loading map preset from input file
-class LoadFileMode : public ModeSelector
+// Buffered writer of dump text
+// Numbers are formatted by to_chars into DUMP_BUFFER_SIZE buffer,
+// stream gets one write per full buffer
+class CellLineWriter
 {
 private:
+    std::ostream& _out;
+    std::vector<char> _buffer;
+    size_t _used = 0;
 
 public:
-    virtual void ConfigLogic(ModeContext context)
+    CellLineWriter(std::ostream& out) : _out(out), _buffer(DUMP_BUFFER_SIZE) {}
+    ~CellLineWriter() { Flush(); }
+
+    void PutChar(char c)
     {
-        Field* f = new Field(DEFAULT_FIELD_SIZE);
-        Logic* l = new Logic(f, 3, 23);
-        PresetParser* p = new PresetParser(context.inputFile);
-        l->LoadPreset(p);
-        *(context.logic) = l;
-        *(context.prepar) = p;
+        if (_used == _buffer.size()) Flush();
+        _buffer[_used++] = c;
     }
-};
 
-// Offline mode. Evaluates map state and dumps result into other file
-class OfflineMode : public ModeSelector
-{
-public:
-    virtual void ConfigLogic(ModeContext context)
+    void PutNumber(int64_t v)
     {
-        std::cout << "Evaluating state..." << std::endl;
-
-
-        Field* f = new Field(DEFAULT_FIELD_SIZE);
-        Logic* l = new Logic(f, 3, 23);
-        PresetParser* p = new PresetParser(context.inputFile);
-        l->LoadPreset(p);
+        // 20 characters of the longest int64_t
+        if (_buffer.size() - _used < 24) Flush();
+        _used = std::to_chars(_buffer.data() + _used, _buffer.data() + _buffer.size(), v).ptr
+              - _buffer.data();
+    }
 
-        for (int i = 0; i < context.offline_ticks; i++)
-            l->Tick();
-        std::queue<CellOp*> q;
-        l->FillQueueWithCurrentState(&q);
-        p->Dump(&q, context.outputFile);
+    // "<x> <y>" line of cell (x, y), "<y> <x>" if columns go first
+    void Write(int64_t x, int64_t y, bool column_first = false)
+    {
+        PutNumber(column_first ? y : x);
+        PutChar(' ');
+        PutNumber(column_first ? x : y);
+        PutChar('\n');
+    }
 
-        std::cout << "Simulation completed" << std::endl;
-        std::cout << "Created file: " << context.outputFile << std::endl;
-        exit(0);
+    void Flush()
+    {
+        _out.write(_buffer.data(), _used);
+        _used = 0;
     }
 };
 
-class UserInterfaceWrap
+// First column from y on holding cell of given state, m if there is none
+static int nextColumn(const uint64_t* row, int y, int m, bool alive)
 {
-private:
-    Logic* _logic;
-    PresetParser* _prepar;
-    int _ticks = 0;
-    bool _help = false;
-    std::string _dump_file = std::string("");
-
-    // Error indicator for commands
-    // 0 - no errors
-    // 1 - tick error
-    // 2 - dump error
-    // 3 - help error
-    // 4 - exit error
-    int _errNo = 0;
-    std::string _error_msg = std::string("");
-
-
-    // Set game mode using ModeSelector and loading file by name
-    void setMode(ModeSelector* mode, std::string inputFile, std::string outputFile = std::string(""), int offline_ticks = 0)
+    size_t words = ((size_t)m + 63) / 64;
+    size_t w = (size_t)y >> 6;
+    if (w >= words) return m;
+    uint64_t bits = (alive ? row[w] : ~row[w]) & (~(uint64_t)0 << (y & 63));
+    while (bits == 0)
     {
-        mode->ConfigLogic(ModeContext{ &_logic, &_prepar, inputFile, outputFile, offline_ticks});
+        if (++w >= words) return m;
+        bits = alive ? row[w] : ~row[w];
     }
-    // Draw map
-    void drawField()
+    return (int)std::min<size_t>(w * 64 + lowestBit(bits), (size_t)m);
+}
+
+// Writes RLE run "<count><tag>", lines are kept within 70 characters
+static void putRleRun(CellLineWriter& writer, int& line_length, long long count, char tag)
+{
+    int length = 1;
+    if (count > 1)
+        for (long long c = count; c > 0; c /= 10) length++;
+    if (line_length + length > 70)
     {
-        _logic->DrawField();
-        for (int i = 0; i < _logic->GetFieldWidth(); i++)
-            std::cout << "=";
-        std::cout << END_OF_FIELD_CHAR << std::endl;
+        writer.PutChar('\n');
+        line_length = 0;
     }
-    // Draw info box
-    void drawInfo()
+    if (count > 1) writer.PutNumber(count);
+    writer.PutChar(tag);
+    line_length += length;
+}
+
+// Runs are found word by word, empty rows are merged into one "<n>$" run
+void PresetParser::DumpRle(Field* field, std::string output)
+{
+    std::ofstream fout(output, std::ios::binary);
+    fout << "#N " << _presetName << '\n';
+    fout << "#C " << _presetComment << '\n';
+    fout << "x = " << field->getM() << ", y = " << field->getN()
+         << ", rule = B" << maskDigits(_b_mask) << "/S" << maskDigits(_s_mask) << '\n';
+    CellLineWriter writer(fout);
+    int m = field->getM();
+    int line_length = 0;
+    long long rows = 0;
+    for (int x = 0; x < field->getN(); x++)
     {
-        std::cout << "[INFO]----------------------------" << std::endl;
-        if (_prepar == nullptr)
+        const uint64_t* row = field->getRow(x);
+        int y = 0;
+        for (;;)
         {
-            std::cout << "Default loaded preset" << std::endl;
-        }
-        else
-        {
-            std::cout << "Name: " << _prepar->GetName() << std::endl;
-        }
-        if (_errNo != 0)
-        {
-            std::cout << "[Error No. " << _errNo << "]:" << _error_msg << std::endl;
-            _errNo = 0;
+            int from = nextColumn(row, y, m, true);
+            if (from >= m) break;
+            int to = nextColumn(row, from, m, false);
+            if (rows > 0) putRleRun(writer, line_length, rows, '$');
+            rows = 0;
+            if (from > y) putRleRun(writer, line_length, from - y, 'b');
+            putRleRun(writer, line_length, to - from, 'o');
+            y = to;
         }
+        rows++;
     }
-    // Draw box with user input and help
-    void drawUserInput(bool help = false)
+    writer.PutChar('!');
+    writer.PutChar('\n');
+}
+
+// Rows are written up to their last live cell
+void PresetParser::DumpPlaintext(Field* field, std::string output)
+{
+    std::ofstream fout(output, std::ios::binary);
+    fout << "!Name: " << _presetName << '\n';
+    fout << "!" << _presetComment << '\n';
+    CellLineWriter writer(fout);
+    size_t words = field->getRowWords();
+    for (int x = 0; x < field->getN(); x++)
     {
-        std::cout << "[INPUT]---------------------------" << std::endl;
-        if (help)
+        const uint64_t* row = field->getRow(x);
+        int last = -1;
+        for (size_t w = words; w-- > 0;)
         {
-            std::cout << "Type \"tick\" <n> to advance game on n ticks." << std::endl;
-            std::cout << "Type \"dump\" <file> to save state in file." << std::endl;
-            std::cout << "Type \"exit\" to end game." << std::endl;
+            if (row[w] == 0) continue;
+            last = (int)(w * 64 + 63);
+            while (!((row[w] >> (last & 63)) & 1)) last--;
+            break;
         }
-        else std::cout << "Type \"help\" to view commands." << std::endl;
-        std::cout << "Input command: ";
+        for (int y = 0; y <= last; y++)
+            writer.PutChar(((row[y >> 6] >> (y & 63)) & 1) ? 'O' : '.');
+        writer.PutChar('\n');
     }
+}
 
-    void dumpFile()
+void PresetParser::Dump(std::queue<CellOp*>* ops_q, std::string output)
+{
+    bool life106 = isLife106File(output);
+    std::ofstream fout(output, std::ios::binary);
+    dumpHeader(fout, life106);
+    CellLineWriter writer(fout);
+    for (; !ops_q->empty(); ops_q->pop())
     {
-        std::queue<CellOp*> ops_q;
-        _logic->FillQueueWithCurrentState(&ops_q);
-        _prepar->Dump(&ops_q, _dump_file);
-        std::cout << "Dump file created: " << _dump_file << std::endl;
-        _dump_file = std::string("");
+        CellOp* op = ops_q->front();
+        writer.Write(op->x, op->y, life106);
+        delete op;
     }
+}
 
-    void ticks()
+// Dumps live cells straight from packed rows of field
+void PresetParser::Dump(Field* field, std::string output)
+{
+    bool life106 = isLife106File(output);
+    std::ofstream fout(output, std::ios::binary);
+    dumpHeader(fout, life106);
+    CellLineWriter writer(fout);
+    size_t words = field->getRowWords();
+    for (int x = 0; x < field->getN(); x++)
     {
-        while (_ticks > 0)
-        {
-            _logic->Tick();
-            CLEAR_SCREEN
-            drawField();
-            std::cout << "Remained ticks = " << --_ticks << std::endl;
-            sleepcp(SLEEP_TIME_MS);
-        }
+        const uint64_t* row = field->getRow(x);
+        for (size_t w = 0; w < words; w++)
+            for (uint64_t bits = row[w]; bits; bits &= bits - 1)
+                writer.Write(x, (int64_t)(w * 64 + lowestBit(bits)), life106);
     }
+}
 
-    void parseUInput(std::string line)
-    {
-        std::string word = getword(line);
-        if (word == std::string("dump"))
-        {
-            if (line.size() > 5)
-            {
-                std::string arg = line.substr(5);
-                _dump_file = arg;
-            }
-            else
-            {
-                _errNo = 2;
-                _error_msg = std::string("Command \"dump\" requires argument");
-            }
-                
-        }
-        else if (word == std::string("tick"))
+// Dumps live cells of HashLife universe, coordinates are 64-bit
+void PresetParser::Dump(HashLife* universe, std::string output)
+{
+    bool life106 = isLife106File(output);
+    std::ofstream fout(output, std::ios::binary);
+    dumpHeader(fout, life106);
+    CellLineWriter writer(fout);
+    universe->ForEachCell([&writer, life106](int64_t x, int64_t y) {
+        writer.Write(x, y, life106);
+    });
+}
+
+// Dumps live cells of sparse field, coordinates are 64-bit
+void PresetParser::Dump(SparseField* field, std::string output)
+{
+    bool life106 = isLife106File(output);
+    std::ofstream fout(output, std::ios::binary);
+    dumpHeader(fout, life106);
+    CellLineWriter writer(fout);
+    field->ForEachCell([&writer, life106](int64_t x, int64_t y) {
+        writer.Write(x, y, life106);
+    });
+}
+
+int PresetParser::GetB() { return b; }
+int PresetParser::GetS() { return s; }
+uint16_t PresetParser::GetBMask() { return _b_mask; }
+uint16_t PresetParser::GetSMask() { return _s_mask; }
+uint64_t PresetParser::GetGeneration() { return _generation; }
+
+std::string PresetParser::GetComment() { return _presetComment; }
+std::string PresetParser::GetName()    { return _presetName;    }
+
+#pragma endregion
+
+#pragma region Logic
+
+// Sum of active neighbours for cell at (x,y)
+int Logic::activeCellSum(int x, int y)
+{
+    int sum = 0;
+    for (int i = x - 1; i <= x + 1; i++)
+    {
+        for (int j = y - 1; j <= y + 1; j++)
+        {
+            if (i == x && j == y) continue;
+            sum += (_field_ptr->getAt(i, j)) ? 1 : 0;
+        }
+    }
+    return sum;
+}
+// Check sum of neighbour active cells for birth
+// If s == true, it checks S (survival) instead
+// For S better use checkS(sum)
+bool Logic::checkB(int sum, bool check_s)
+{
+    uint16_t mask = check_s ? _s_mask : _b_mask;
+    return (mask >> sum) & 1;
+}
+// Check sum of neighbour active cells for survival
+bool Logic::checkS(int sum)
+{
+    return checkB(sum, true);
+}
+// Scans rows [from, to) of field and writes next iteration
+// of every cell into back buffer
+// Bits are written through getRow(), so bands of several threads
+// never touch the version of back buffer, Tick() marks it once
+void Logic::scanField(int from, int to)
+{
+    for (int i = from; i < to; i++)
+    {
+        uint64_t* row = _back_ptr->getRow(i);
+        for (int j = 0; j < _field_ptr->getM(); j++)
+        {
+            int cellSum  = activeCellSum(i,j);
+            bool alive   = _field_ptr->getAt(i, j);
+            bool birth   = checkB(cellSum);
+            bool survive = checkS(cellSum);
+
+            bool newState = (alive && survive) || birth;
+            uint64_t bit = (uint64_t)1 << (j & 63);
+            if (newState) row[j >> 6] |=  bit;
+            else          row[j >> 6] &= ~bit;
+        }
+    }
+}
+
+// For debug. Prints map of active neighbours
+void Logic::printCellSums()
+{
+    for (int i = 0; i < _field_ptr->getN(); i++)
+    {
+        for (int j = 0; j < _field_ptr->getM(); j++)
+            std::cout << activeCellSum(i, j);
+        std::cout << std::endl;
+    }
+}
+
+// Default logic B3/S23
+Logic::Logic(Field* field)
+{
+    SetRule(digitMask(3), digitMask(23));
+    _field_ptr = field;
+    SetKernel(bestKernelIsa());
+}
+// Logic with Bb/Ss parameters
+Logic::Logic(Field* field, int b, int s)
+{
+    SetRule(digitMask(b), digitMask(s));
+    _field_ptr = field;
+    SetKernel(bestKernelIsa());
+}
+Logic::~Logic()
+{
+    delete _pool;
+    delete _back_ptr;
+}
+void Logic::SetField(Field* field)
+{
+    _field_ptr = field;
+}
+Field* Logic::GetField()
+{
+    return _field_ptr;
+}
+// Back buffer of the same size as the field
+// Allocated only when there is none or field size has changed
+void Logic::prepareBackBuffer()
+{
+    if (_back_ptr != nullptr
+        && _back_ptr->getN() == _field_ptr->getN()
+        && _back_ptr->getM() == _field_ptr->getM())
+        return;
+    delete _back_ptr;
+    _back_ptr = new Field(_field_ptr->getN(), _field_ptr->getM());
+    _stats.allocations++;
+}
+// Next generation of rows [from, to) computed word by word over packed rows
+// Rows of the field are read, rows of back buffer are written
+void Logic::tickPacked(int from, int to)
+{
+    int n = _field_ptr->getN();
+    int m = _field_ptr->getM();
+    size_t words = _field_ptr->getRowWords();
+    uint64_t last_mask = _field_ptr->getLastWordMask();
+
+    for (int x = from; x < to; x++)
+    {
+        const uint64_t* up   = _field_ptr->getRow(x == 0 ? n - 1 : x - 1);
+        const uint64_t* down = _field_ptr->getRow(x == n - 1 ? 0 : x + 1);
+        _kernel(up, _field_ptr->getRow(x), down, _back_ptr->getRow(x), 0, words, words, m, last_mask, _b_mask, _s_mask);
+        // Rows are summarized a few rows behind: still in cache,
+        // but vector stores of the kernel are done, word loads do not wait for them
+        if (_summary_tracking && x - SUMMARY_LAG >= from)
+            _row_summary[x - SUMMARY_LAG] = summarize(_back_ptr, x - SUMMARY_LAG, x - SUMMARY_LAG + 1, 0, words);
+    }
+    if (!_summary_tracking) return;
+    for (int x = std::max(from, to - SUMMARY_LAG); x < to; x++)
+        _row_summary[x] = summarize(_back_ptr, x, x + 1, 0, words);
+}
+void Logic::SetEngine(TickEngine engine) { _engine = engine; }
+TickEngine Logic::GetEngine()            { return _engine;   }
+// Throws std::invalid_argument if CPU does not support the kernel
+void Logic::SetKernel(KernelIsa isa)
+{
+    _kernel = getPackedRowKernel(isa);
+    _row_count = getPackedRowCount(isa);
+    _kernel_isa = isa;
+}
+KernelIsa Logic::GetKernel() { return _kernel_isa; }
+// True if tile of field has live cells
+bool Logic::tileHasCells(Field* field, int tile)
+{
+    int x0 = (tile / _tile_cols) * TILE_ROWS;
+    int x1 = std::min(x0 + TILE_ROWS, field->getN());
+    size_t w0 = (size_t)(tile % _tile_cols) * TILE_WORDS;
+    size_t w1 = std::min(w0 + TILE_WORDS, field->getRowWords());
+    for (int x = x0; x < x1; x++)
+    {
+        const uint64_t* row = field->getRow(x);
+        uint64_t any = 0;
+        for (size_t w = w0; w < w1; w++)
+            any |= row[w];
+        if (any != 0) return true;
+    }
+    return false;
+}
+// Rebuilds tile grid and tile lists if the field was changed not by
+// Tick() (or was replaced, or rule was changed) since the last tiled tick
+// Back buffer is cleared, so tiles with live cells act as changed ones:
+// all other tiles are dead without live neighbours and stay dead
+void Logic::prepareTiles()
+{
+    int tile_rows = (_field_ptr->getN() + TILE_ROWS - 1) / TILE_ROWS;
+    int tile_cols = (int)((_field_ptr->getRowWords() + TILE_WORDS - 1) / TILE_WORDS);
+    if (_tiles_valid
+        && _tiles_field == _field_ptr
+        && _tiles_version == _field_ptr->getVersion()
+        && _tiles_b_mask == _b_mask && _tiles_s_mask == _s_mask
+        && _tile_rows == tile_rows && _tile_cols == tile_cols)
+        return;
+
+    _tile_rows = tile_rows;
+    _tile_cols = tile_cols;
+    _tiles_b_mask = _b_mask;
+    _tiles_s_mask = _s_mask;
+    int tiles = tile_rows * tile_cols;
+    _tile_stamp.assign(tiles, 0);
+    _tile_round = 0;
+    _changed_tiles.clear();
+    _next_changed_tiles.clear();
+    _scheduled_tiles.clear();
+    _changed_tiles.reserve(tiles);
+    _next_changed_tiles.reserve(tiles);
+    _scheduled_tiles.reserve(tiles);
+
+    for (int t = 0; t < tiles; t++)
+        if (tileHasCells(_field_ptr, t))
+            _changed_tiles.push_back(t);
+    _back_ptr->Clear();
+    _tiles_fresh = true;
+    _tiles_valid = true;
+}
+// Puts tile to the list of this tick, once
+void Logic::scheduleTile(int tile_row, int tile_col)
+{
+    tile_row = (tile_row + _tile_rows) % _tile_rows;
+    tile_col = (tile_col + _tile_cols) % _tile_cols;
+    int tile = tile_row * _tile_cols + tile_col;
+    if (_tile_stamp[tile] == _tile_round) return;
+    _tile_stamp[tile] = _tile_round;
+    _scheduled_tiles.push_back(tile);
+}
+// Next state of one tile into back buffer
+// Tile that differs from its previous state goes to worker's changed list
+void Logic::stepTile(int tile, int worker)
+{
+    int n = _field_ptr->getN();
+    int m = _field_ptr->getM();
+    size_t words = _field_ptr->getRowWords();
+    uint64_t last_mask = _field_ptr->getLastWordMask();
+    int x0 = (tile / _tile_cols) * TILE_ROWS;
+    int x1 = std::min(x0 + TILE_ROWS, n);
+    size_t w0 = (size_t)(tile % _tile_cols) * TILE_WORDS;
+    size_t w1 = std::min(w0 + TILE_WORDS, words);
+
+    uint64_t diff = 0;
+    for (int x = x0; x < x1; x++)
+    {
+        const uint64_t* up   = _field_ptr->getRow(x == 0 ? n - 1 : x - 1);
+        const uint64_t* mid  = _field_ptr->getRow(x);
+        const uint64_t* down = _field_ptr->getRow(x == n - 1 ? 0 : x + 1);
+        uint64_t* out = _back_ptr->getRow(x);
+        _kernel(up, mid, down, out, w0, w1, words, m, last_mask, _b_mask, _s_mask);
+        for (size_t w = w0; w < w1; w++)
+            diff |= out[w] ^ mid[w];
+    }
+    if (diff != 0)
+    {
+        _worker_changed_tiles[worker].push_back(tile);
+        // Tile is still in cache
+        if (_summary_in_tiles)
+            _tile_summary[tile] = summarize(_back_ptr, x0, x1, w0, w1);
+    }
+}
+// Tiles taken from work-stealing queues until all of them are done
+void Logic::runTiles(int worker)
+{
+    int tile;
+    while (_scheduler.Next(worker, tile))
+        stepTile(tile, worker);
+}
+// Tiled step: only tiles changed by the previous tick and their
+// neighbours are computed. Inputs of any other tile are the same as
+// one tick ago, so its next state equals its current state, which is
+// exactly what back buffer (previous generation) already holds there
+void Logic::tickTiles()
+{
+    prepareTiles();
+    _tile_round++;
+    _scheduled_tiles.clear();
+
+    int tiles = _tile_rows * _tile_cols;
+    // With B0 dead cells are born without neighbours,
+    // so right after rebuild every tile can change
+    if (_tiles_fresh && (_b_mask & 1))
+    {
+        for (int t = 0; t < tiles; t++)
+            scheduleTile(t / _tile_cols, t % _tile_cols);
+    }
+    else
+    {
+        for (int tile : _changed_tiles)
+        {
+            int tr = tile / _tile_cols, tc = tile % _tile_cols;
+            for (int dr = -1; dr <= 1; dr++)
+                for (int dc = -1; dc <= 1; dc++)
+                    scheduleTile(tr + dr, tc + dc);
+        }
+    }
+    _tiles_fresh = false;
+
+    // Contiguous chunks of scheduled tiles per worker, the rest is balanced by stealing
+    int workers = GetThreads();
+    size_t total = _scheduled_tiles.size();
+    _scheduler.Reset(workers);
+    _worker_changed_tiles.resize(workers);
+    for (int k = 0; k < workers; k++)
+    {
+        _worker_changed_tiles[k].clear();
+        for (size_t i = total * k / workers; i < total * (k + 1) / workers; i++)
+            _scheduler.Push(k, _scheduled_tiles[i]);
+    }
+
+    if (_pool != nullptr)
+        _pool->RunOnAll([this](int worker) { runTiles(worker); });
+    else
+        runTiles(0);
+
+    _next_changed_tiles.clear();
+    for (auto& list : _worker_changed_tiles)
+        _next_changed_tiles.insert(_next_changed_tiles.end(), list.begin(), list.end());
+    std::swap(_changed_tiles, _next_changed_tiles);
+
+    _tiles_evaluated = (long long)total;
+    _tiles_skipped = (long long)tiles - (long long)total;
+}
+// Hash of tile of field, tile index is mixed in,
+// so equal tiles at different places hash differently
+static uint64_t hashTile(Field* field, int tile, int tile_cols)
+{
+    int x0 = (tile / tile_cols) * TILE_ROWS;
+    int x1 = std::min(x0 + TILE_ROWS, field->getN());
+    size_t w0 = (size_t)(tile % tile_cols) * TILE_WORDS;
+    size_t w1 = std::min(w0 + TILE_WORDS, field->getRowWords());
+    uint64_t h = ((uint64_t)tile + 1) * 0x9E3779B97F4A7C15ull;
+    for (int x = x0; x < x1; x++)
+    {
+        const uint64_t* row = field->getRow(x);
+        for (size_t w = w0; w < w1; w++)
+        {
+            h = (h ^ row[w]) * 0xBF58476D1CE4E5B9ull;
+            h ^= h >> 31;
+        }
+    }
+    return h;
+}
+// 64-bit hash of cells of the field
+uint64_t Logic::GetStateHash()
+{
+    if (_hash_valid && _hash_field == _field_ptr && _hash_version == _field_ptr->getVersion())
+        return _state_hash;
+
+    int tile_cols = (int)((_field_ptr->getRowWords() + TILE_WORDS - 1) / TILE_WORDS);
+    int tiles = (_field_ptr->getN() + TILE_ROWS - 1) / TILE_ROWS * tile_cols;
+    _tile_hash.resize(tiles);
+    _state_hash = 0;
+    for (int t = 0; t < tiles; t++)
+    {
+        _tile_hash[t] = hashTile(_field_ptr, t, tile_cols);
+        _state_hash ^= _tile_hash[t];
+    }
+    _hash_valid = true;
+    _hash_field = _field_ptr;
+    _hash_version = _field_ptr->getVersion();
+    return _state_hash;
+}
+// Tiles not in changed list hold the same cells as before the tick,
+// so their hashes stay. Tile grid of hashes is the grid of tiled tick
+void Logic::updateStateHash(uint64_t version_before)
+{
+    if (!_hash_valid || _hash_field != _field_ptr || _hash_version != version_before)
+        return;
+    for (int tile : _changed_tiles)
+    {
+        uint64_t h = hashTile(_field_ptr, tile, _tile_cols);
+        _state_hash ^= _tile_hash[tile] ^ h;
+        _tile_hash[tile] = h;
+    }
+    _hash_version = _field_ptr->getVersion();
+}
+long long Logic::GetTilesEvaluated() { return _tiles_evaluated; }
+long long Logic::GetTilesSkipped()   { return _tiles_skipped;   }
+// Next generation of rows [from, to) by selected engine
+void Logic::stepRows(int from, int to)
+{
+    if (_engine == ENGINE_SWAR)
+        tickPacked(from, to);
+    else
+    {
+        scanField(from, to);
+        for (int x = from; x < to && _summary_tracking; x++)
+            _row_summary[x] = summarize(_back_ptr, x, x + 1, 0, _back_ptr->getRowWords());
+    }
+}
+// Rows of band processed by worker
+// Band k of T is rows [N*k/T, N*(k+1)/T)
+void Logic::stepBand(int worker)
+{
+    long long n = _field_ptr->getN();
+    int threads = _pool->GetThreads();
+    stepRows((int)(n * worker / threads), (int)(n * (worker + 1) / threads));
+}
+// Next generation is written into back buffer,
+// then buffers of the field and back buffer are swapped
+// With several threads every worker writes its own band of rows,
+// rows around band borders are only read from the field
+void Logic::Tick()
+{
+    auto start = std::chrono::steady_clock::now();
+    uint64_t version_before = _field_ptr->getVersion();
+    prepareBackBuffer();
+    bool tiled = _schedule == SCHEDULE_TILES && _engine == ENGINE_SWAR;
+    if (tiled)
+    {
+        _summary_in_tiles = _summary_tracking && _tile_summary_valid && _summary_valid
+                         && _summary_field == _field_ptr && _summary_version == version_before;
+        tickTiles();
+        _field_ptr->Swap(*_back_ptr);
+        _tiles_field = _field_ptr;
+        _tiles_version = _field_ptr->getVersion();
+        updateStateHash(version_before);
+    }
+    else
+    {
+        _tiles_valid = false;
+        _tiles_evaluated = 0;
+        _tiles_skipped = 0;
+        _row_summary.resize(_field_ptr->getN());
+        if (_pool != nullptr)
+            _pool->RunOnAll([this](int worker) { stepBand(worker); });
+        else
+            stepRows(0, _field_ptr->getN());
+        _back_ptr->markModified();
+        _field_ptr->Swap(*_back_ptr);
+    }
+    _generation++;
+    updateSummary(tiled);
+
+    if (_stats_enabled)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        recordTick((uint64_t)ns);
+    }
+}
+
+#pragma region CellSummary
+
+// Extent of a row comes from its first and last non-empty words
+Logic::CellSummary Logic::summarize(Field* field, int x0, int x1, size_t w0, size_t w1)
+{
+    CellSummary summary;
+    for (int x = x0; x < x1; x++)
+    {
+        const uint64_t* row = field->getRow(x);
+        size_t first = w0, last = w1;
+        while (first < w1 && row[first] == 0) first++;
+        if (first == w1) continue;
+        while (row[last - 1] == 0) last--;
+        if (summary.population == 0) summary.min_x = x;
+        summary.max_x = x;
+        summary.population += _row_count(row, first, last);
+        summary.min_y = std::min(summary.min_y, (int)first * 64 + lowestBit(row[first]));
+        summary.max_y = std::max(summary.max_y, (int)(last - 1) * 64 + highestBit(row[last - 1]));
+    }
+    return summary;
+}
+void Logic::mergeSummary(CellSummary& into, const CellSummary& part)
+{
+    into.population += part.population;
+    into.min_x = std::min(into.min_x, part.min_x);
+    into.min_y = std::min(into.min_y, part.min_y);
+    into.max_x = std::max(into.max_x, part.max_x);
+    into.max_y = std::max(into.max_y, part.max_y);
+}
+// Tile grid is the grid of tiled tick
+void Logic::summarizeField()
+{
+    int tile_cols = (int)((_field_ptr->getRowWords() + TILE_WORDS - 1) / TILE_WORDS);
+    int tiles = (_field_ptr->getN() + TILE_ROWS - 1) / TILE_ROWS * tile_cols;
+    _tile_summary.resize(tiles);
+    _summary = CellSummary();
+    for (int t = 0; t < tiles; t++)
+    {
+        int x0 = (t / tile_cols) * TILE_ROWS;
+        size_t w0 = (size_t)(t % tile_cols) * TILE_WORDS;
+        _tile_summary[t] = summarize(_field_ptr, x0, std::min(x0 + TILE_ROWS, _field_ptr->getN()),
+                                     w0, std::min(w0 + TILE_WORDS, _field_ptr->getRowWords()));
+        mergeSummary(_summary, _tile_summary[t]);
+    }
+    _tile_summary_valid = true;
+    _summary_valid = true;
+    _summary_field = _field_ptr;
+    _summary_version = _field_ptr->getVersion();
+}
+// Summary is kept only after it was asked for once.
+// Band tick summarized every row it wrote, rows are merged in O(rows).
+// Tiled tick summarized tiles it changed, tiles are merged in O(tiles),
+// nothing is done if no tile changed
+void Logic::updateSummary(bool tiled)
+{
+    if (!_summary_tracking)
+    {
+        _summary_valid = false;
+        return;
+    }
+    if (!tiled)
+    {
+        _summary = CellSummary();
+        for (int x = 0; x < _field_ptr->getN(); x++)
+            mergeSummary(_summary, _row_summary[x]);
+        _tile_summary_valid = false;
+    }
+    else
+    {
+        if (!_summary_in_tiles)
+        {
+            _summary_valid = false;
+            return;
+        }
+        if (!_changed_tiles.empty())
+        {
+            _summary = CellSummary();
+            for (const CellSummary& part : _tile_summary)
+                mergeSummary(_summary, part);
+        }
+    }
+    _summary_valid = true;
+    _summary_field = _field_ptr;
+    _summary_version = _field_ptr->getVersion();
+}
+uint64_t Logic::GetPopulation()
+{
+    _summary_tracking = true;
+    if (!_summary_valid || _summary_field != _field_ptr || _summary_version != _field_ptr->getVersion())
+        summarizeField();
+    return _summary.population;
+}
+bool Logic::GetBoundingBox(int* min_x, int* min_y, int* max_x, int* max_y)
+{
+    if (GetPopulation() == 0) return false;
+    *min_x = _summary.min_x;
+    *min_y = _summary.min_y;
+    *max_x = _summary.max_x;
+    *max_y = _summary.max_y;
+    return true;
+}
+
+#pragma endregion
+
+#pragma region Stats
+
+void Logic::countChanges(int x0, int x1, size_t w0, size_t w1, uint64_t& births, uint64_t& deaths)
+{
+    for (int x = x0; x < x1; x++)
+    {
+        const uint64_t* now = _field_ptr->getRow(x);
+        const uint64_t* before = _back_ptr->getRow(x);
+        for (size_t w = w0; w < w1; w++)
+        {
+            births += bitCount(now[w] & ~before[w]);
+            deaths += bitCount(before[w] & ~now[w]);
+        }
+    }
+}
+// Back buffer holds the previous generation right after the swap.
+// Tiled tick changes only tiles of its changed list, others are not compared
+void Logic::recordTick(uint64_t ns)
+{
+    int n = _field_ptr->getN();
+    size_t words = _field_ptr->getRowWords();
+    uint64_t area = (uint64_t)n * _field_ptr->getM();
+    uint64_t births = 0, deaths = 0, evaluated = area;
+    if (_schedule == SCHEDULE_TILES && _engine == ENGINE_SWAR)
+    {
+        for (int tile : _changed_tiles)
+        {
+            int x0 = (tile / _tile_cols) * TILE_ROWS;
+            size_t w0 = (size_t)(tile % _tile_cols) * TILE_WORDS;
+            countChanges(x0, std::min(x0 + TILE_ROWS, n), w0, std::min(w0 + TILE_WORDS, words), births, deaths);
+        }
+        evaluated = std::min(area, (uint64_t)_tiles_evaluated * TILE_ROWS * TILE_WORDS * 64);
+    }
+    else
+        countChanges(0, n, 0, words, births, deaths);
+
+    _tick_latency.Record(ns);
+    _stats.generation = _generation;
+    _stats.ticks++;
+    _stats.last_tick_ns = ns;
+    _stats.total_tick_ns += ns;
+    _stats.last_cells_evaluated = evaluated;
+    _stats.cells_evaluated += evaluated;
+    _stats.last_cells_changed = births + deaths;
+    _stats.cells_changed += births + deaths;
+    _stats.births += births;
+    _stats.deaths += deaths;
+}
+void Logic::EnableStats(bool enable)
+{
+    if (enable && !_stats_enabled)
+        ResetStats();
+    _stats_enabled = enable;
+}
+bool Logic::StatsEnabled() { return _stats_enabled; }
+TickStats Logic::GetStats()
+{
+    TickStats stats = _stats;
+    stats.generation = _generation;
+    stats.population = GetPopulation();
+    stats.p50_tick_ns = _tick_latency.Percentile(0.5);
+    stats.p99_tick_ns = _tick_latency.Percentile(0.99);
+    stats.max_tick_ns = _tick_latency.GetMax();
+    return stats;
+}
+void Logic::ResetStats()
+{
+    _stats = TickStats();
+    _tick_latency.Reset();
+}
+
+#pragma endregion
+
+void Logic::SetSchedule(TickSchedule schedule) { _schedule = schedule; }
+TickSchedule Logic::GetSchedule()              { return _schedule;    }
+// Rule is compiled once into masks used by every engine
+void Logic::SetRule(uint16_t b_mask, uint16_t s_mask)
+{
+    _b_mask = b_mask & 0x1FF;
+    _s_mask = s_mask & 0x1FF;
+}
+uint16_t Logic::GetBMask()                     { return _b_mask;      }
+uint16_t Logic::GetSMask()                     { return _s_mask;      }
+uint64_t Logic::GetGeneration()                { return _generation;  }
+void Logic::SetGeneration(uint64_t generation) { _generation = generation; }
+// Number of threads used by Tick()
+// Pool of workers is created once and reused by every tick
+void Logic::SetThreads(int threads)
+{
+    if (threads < 1)
+        throw std::invalid_argument("Number of threads must be positive");
+    if (threads == GetThreads()) return;
+    delete _pool;
+    _pool = (threads > 1) ? new ThreadPool(threads) : nullptr;
+}
+int Logic::GetThreads() { return _pool == nullptr ? 1 : _pool->GetThreads(); }
+void Logic::DrawField() { _field_ptr->Draw(); }
+int Logic::GetFieldHeight() { return _field_ptr->getN(); }
+int Logic::GetFieldWidth() { return _field_ptr->getM(); }
+
+void Logic::LoadPreset(PresetParser* prepar)
+{
+    _field_ptr->Clear();
+    long long overlaps = prepar->Load(_field_ptr);
+    SetRule(prepar->GetBMask(), prepar->GetSMask());
+    _generation = prepar->GetGeneration();
+    if (overlaps > 0)
+    {
+        std::ostringstream oss;
+        oss << "[Note] Overlaping coordinats on input: " << overlaps << " cells";
+        load_messages.push_back(oss.str());
+    }
+}
+void Logic::LoadDefault()
+{
+    _field_ptr->Clear();
+    _field_ptr->DefaultPreset();
+    _generation = 0;
+}
+
+void Logic::FillQueueWithCurrentState(std::queue<CellOp*>* ops_q)
+{
+    for (int i = 0; i < _field_ptr->getN(); i++)
+    {
+        for (int j = 0; j < _field_ptr->getM(); j++)
+        {
+            if (_field_ptr->getAt(i, j))
+                ops_q->push(new CellOp{ i, j, true });
+        }
+    }
+}
+
+std::vector<std::string> Logic::TakeMessages()
+{
+    std::vector<std::string> messages;
+    messages.swap(load_messages);
+    return messages;
+}
+
+void Logic::PrintMessages()
+{
+    for (auto iter = load_messages.begin(); iter != load_messages.end(); iter++)
+    {
+        std::cout << *iter << std::endl;
+    }
+
+    load_messages.clear();
+}
+
+bool Logic::GetAt(int x, int y) { return _field_ptr->getAt(x, y); }
+
+#pragma endregion
+
+#pragma region Modes
+
+// Default mode, loading default map preset
+// Ignores input file
+// Sets default prepar
+void DefaultMode::ConfigLogic(ModeContext context)
+{
+    Field* f = new Field(DEFAULT_FIELD_SIZE);
+    Logic* l = new Logic(f, 3, 23);
+    l->SetThreads(context.threads);
+    l->LoadDefault();
+    *(context.logic) = l;
+    *(context.prepar) = new PresetParser("");
+}
+
+// Mode with loading map preset from input file
+void LoadFileMode::ConfigLogic(ModeContext context)
+{
+    Field* f = new Field(DEFAULT_FIELD_SIZE);
+    Logic* l = new Logic(f, 3, 23);
+    l->SetThreads(context.threads);
+    PresetParser* p = new PresetParser(context.inputFile);
+    l->LoadPreset(p);
+    *(context.logic) = l;
+    *(context.prepar) = p;
+}
+
+// Unbounded engines can not run B0 rules, every empty cell would be born
+// Run is stopped like on wrong arguments, field engine handles such presets
+static void rejectBirthOnZero(PresetParser& p, const char* engine)
+{
+    if (!(p.GetBMask() & 1)) return;
+    std::cout << "Incorrect usage." << std::endl;
+    std::cout << "Engine " << engine << " does not support B0 rules, use -e field" << std::endl;
+    exit(1);
+}
+
+// Offline run of preset over unbounded HashLife universe
+static void runHashLife(ModeContext context)
+{
+    PresetParser p(context.inputFile);
+    // Rule of preset is known once it is parsed
+    HashLife h(digitMask(3), digitMask(23));
+    p.ForEachCell([&h](int x, int y) { h.SetCell(x, y, true); });
+    rejectBirthOnZero(p, "hashlife");
+    h.SetRule(p.GetBMask(), p.GetSMask());
+
+    if (context.step_pow2 >= 0)
+        h.StepPow2(context.step_pow2);
+    else
+        h.Step((uint64_t)context.offline_ticks);
+    p.Dump(&h, context.outputFile);
+
+    std::cout << "Generation: " << h.GetGeneration() << std::endl;
+    std::cout << "Population: " << h.GetPopulation() << std::endl;
+}
+
+// Offline run of preset over unbounded SparseField
+static void runSparse(ModeContext context)
+{
+    PresetParser p(context.inputFile);
+    // Rule of preset is known once it is parsed
+    SparseField field(digitMask(3), digitMask(23));
+    p.ForEachCell([&field](int x, int y) { field.SetCell(x, y, true); });
+    rejectBirthOnZero(p, "sparse");
+    field.SetRule(p.GetBMask(), p.GetSMask());
+
+    long long ticks = context.offline_ticks;
+    if (context.step_pow2 >= 0)
+        ticks = 1LL << context.step_pow2;
+    field.Step((uint64_t)ticks);
+    p.Dump(&field, context.outputFile);
+
+    std::cout << "Generation: " << field.GetGeneration() << std::endl;
+    std::cout << "Population: " << field.GetPopulation() << std::endl;
+    std::cout << "Chunks: " << field.GetChunkCount() << std::endl;
+}
+
+// Offline mode. Evaluates map state and dumps result into other file
+void OfflineMode::ConfigLogic(ModeContext context)
+{
+    std::cout << "Evaluating state..." << std::endl;
+
+    if (context.engine == OFFLINE_HASHLIFE || context.engine == OFFLINE_SPARSE)
+    {
+        if (context.engine == OFFLINE_HASHLIFE) runHashLife(context);
+        else                                    runSparse(context);
+        std::cout << "Simulation completed" << std::endl;
+        std::cout << "Created file: " << context.outputFile << std::endl;
+        exit(0);
+    }
+
+    Field* f = new Field(DEFAULT_FIELD_SIZE);
+    Logic* l = new Logic(f, 3, 23);
+    l->SetThreads(context.threads);
+    // Long runs mostly settle down, only changing tiles are computed
+    l->SetSchedule(SCHEDULE_TILES);
+    bool resume = !context.resumeFile.empty();
+    PresetParser* p = new PresetParser(resume ? context.resumeFile : context.inputFile);
+    l->LoadPreset(p);
+
+    // Resumed run continues to the generation requested for the whole run,
+    // otherwise ticks are counted from the generation of preset
+    uint64_t ticks = (uint64_t)context.offline_ticks;
+    if (context.step_pow2 >= 0)
+        ticks = (uint64_t)1 << context.step_pow2;
+    uint64_t target = resume ? ticks : l->GetGeneration() + ticks;
+    if (resume)
+        std::cout << "Resuming from generation " << l->GetGeneration() << std::endl;
+
+    CheckpointWriter* checkpoints = nullptr;
+    std::string checkpoint_file = context.outputFile + ".checkpoint" + SNAPSHOT_EXTENSION;
+    if (context.checkpoint_every > 0)
+        checkpoints = new CheckpointWriter(p, checkpoint_file);
+    MetricsExporter* metrics = nullptr;
+    if (!context.metricsFile.empty())
+    {
+        try
+        {
+            metrics = new MetricsExporter(context.metricsFile);
+        }
+        catch (const std::exception& e)
+        {
+            std::cout << e.what() << std::endl;
+            exit(1);
+        }
+        l->EnableStats(true);
+    }
+
+    // Once the field repeats itself, whole periods up to target are skipped
+    CycleDetector cycles;
+    if (context.detect_cycles)
+        cycles.Observe(l);
+    while (l->GetGeneration() < target)
+    {
+        l->Tick();
+        if (checkpoints != nullptr && l->GetGeneration() % context.checkpoint_every == 0)
+            checkpoints->Submit(l->GetField(), l->GetGeneration());
+        if (metrics != nullptr && l->GetGeneration() % context.metrics_every == 0)
+            metrics->Export(l->GetStats());
+        if (context.detect_cycles && cycles.Observe(l))
+        {
+            uint64_t left = target - l->GetGeneration();
+            uint64_t rest = left % cycles.GetPeriod();
+            std::cout << "Cycle detected: period " << cycles.GetPeriod()
+                      << " starting at generation " << cycles.GetStart() << std::endl;
+            std::cout << "Generations skipped: " << left - rest << std::endl;
+            for (uint64_t i = 0; i < rest; i++)
+                l->Tick();
+            l->SetGeneration(target);
+        }
+    }
+    p->Save(l->GetField(), context.outputFile, l->GetGeneration());
+
+    if (metrics != nullptr)
+    {
+        TickStats stats = l->GetStats();
+        metrics->Export(stats);
+        std::cout << "Tick p50/p99: " << stats.p50_tick_ns << "/"
+                  << stats.p99_tick_ns << " ns" << std::endl;
+        std::cout << "Metrics written: " << context.metricsFile << std::endl;
+        delete metrics;
+    }
+    if (checkpoints != nullptr)
+    {
+        checkpoints->Wait();
+        std::cout << "Checkpoints written: " << checkpoints->GetWritten()
+                  << " (" << checkpoint_file << ")" << std::endl;
+        if (!checkpoints->GetError().empty())
+            std::cout << "Checkpoint failed: " << checkpoints->GetError() << std::endl;
+        delete checkpoints;
+    }
+    std::cout << "Simulation completed" << std::endl;
+    std::cout << "Created file: " << context.outputFile << std::endl;
+    exit(0);
+}
+
+// Batch mode. Runs many boards on a thread pool and writes one results line per board
+void BatchMode::ConfigLogic(ModeContext context)
+{
+    // Seed boards are made by workers, only manifest and directory boards are listed
+    bool seeds = context.batchSource.empty();
+    std::vector<SoupJob> jobs;
+    try
+    {
+        if (!seeds)
+            jobs = SoupSearch::JobsFromSource(context.batchSource);
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+        exit(1);
+    }
+
+    if (seeds)
+        std::cout << "Evaluating boards of seeds " << context.seed_first << ".." << context.seed_last << "..." << std::endl;
+    else
+        std::cout << "Evaluating " << jobs.size() << " boards..." << std::endl;
+    SoupSearch search(context.threads);
+    if (context.offline_ticks > 0)
+        search.SetGenerations((uint64_t)context.offline_ticks);
+    std::vector<SoupResult> results;
+    try
+    {
+        results = seeds ? search.RunSeeds(context.seed_first, context.seed_last) : search.Run(jobs);
+    }
+    catch (const std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+        exit(1);
+    }
+
+    std::ofstream out(context.outputFile, std::ios::binary);
+    if (!out.is_open())
+    {
+        std::cout << "Can not create file: " << context.outputFile << std::endl;
+        exit(1);
+    }
+    if (seeds) SoupSearch::WriteSeedResults(out, context.seed_first, results);
+    else       SoupSearch::WriteResults(out, jobs, results);
+    out.close();
+
+    size_t settled = 0;
+    for (const SoupResult& r : results)
+        if (r.period != 0) settled++;
+    std::cout << "Boards settled: " << settled << " of " << results.size() << std::endl;
+    std::cout << "Created file: " << context.outputFile << std::endl;
+    exit(0);
+}
+
+#pragma endregion
+
+#pragma region UserInterfaceWrap
+
+// Set game mode using ModeSelector and loading file by name
+// Logic and prepar pointers of context are set to this object's ones
+void UserInterfaceWrap::setMode(ModeSelector* mode, ModeContext context)
+{
+    context.logic = &_logic;
+    context.prepar = &_prepar;
+    mode->ConfigLogic(context);
+}
+#pragma region DumpQueue
+
+DumpQueue::DumpQueue(PresetParser* prepar)
+    : _prepar(prepar)
+{
+    _thread = std::thread(&DumpQueue::run, this);
+}
+
+DumpQueue::~DumpQueue()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cv.notify_one();
+    _thread.join();
+}
+
+// Field is copied on calling thread, outside of the lock
+void DumpQueue::Push(Field* field, uint64_t generation, const std::string& file)
+{
+    DumpJob job;
+    job.field.reset(new Field(*field));
+    job.generation = generation;
+    job.file = file;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.push_back(std::move(job));
+    }
+    _cv.notify_one();
+}
+
+std::vector<std::string> DumpQueue::TakeResults()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<std::string> results;
+    results.swap(_results);
+    return results;
+}
+
+// Jobs left when stopping are still written
+void DumpQueue::run()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true)
+    {
+        _cv.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+        if (_jobs.empty()) return;
+        DumpJob job = std::move(_jobs.front());
+        _jobs.pop_front();
+        _writing = true;
+        lock.unlock();
+
+        std::string result;
+        try
+        {
+            if (_prepar == nullptr) throw std::invalid_argument("no preset parser");
+            _prepar->Save(job.field.get(), job.file, job.generation);
+            result = "Dump file created: " + job.file;
+        }
+        catch (const std::exception& e)
+        {
+            result = "Dump failed: " + job.file + ": " + e.what();
+        }
+
+        lock.lock();
+        _results.push_back(result);
+        _writing = false;
+        _idle_cv.notify_all();
+    }
+}
+
+void DumpQueue::Wait()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle_cv.wait(lock, [this]() { return _jobs.empty() && !_writing; });
+}
+
+#pragma endregion
+
+// Viewport is fitted to terminal on every frame, so resized terminal is followed
+ViewWindow UserInterfaceWrap::fitViewport(int n, int m, int reserved)
+{
+    int lines, columns;
+    if (terminalSize(&lines, &columns))
+    {
+        _viewport.lines = std::max(1, lines - reserved);
+        _viewport.columns = std::max(1, columns - 1);
+    }
+    _viewport.x = std::max(0, std::min(_viewport.x, n - 1));
+    _viewport.y = std::max(0, std::min(_viewport.y, m - 1));
+    _renderer.SetViewport(_viewport);
+    ViewWindow window;
+    window.x0 = _viewport.x;
+    window.y0 = _viewport.y;
+    window.x1 = _viewport.lines > 0
+        ? (int)std::min<long long>(n, window.x0 + (long long)_viewport.lines * _renderer.GetRowsPerLine()) : n;
+    window.y1 = _viewport.columns > 0
+        ? (int)std::min<long long>(m, window.y0 + (long long)_viewport.columns * _renderer.GetCellsPerChar()) : m;
+    return window;
+}
+// Draw map, frame starts at top left corner and overwrites the previous one,
+// it is written by FrameRenderer::Flush()
+// Viewport is moved to coordinates of the copied window
+void UserInterfaceWrap::drawField(FrameSnapshot& snapshot)
+{
+    Viewport view = _viewport;
+    view.x -= snapshot.window.x0;
+    view.y -= snapshot.window.y0 & ~63;
+    _renderer.SetViewport(view);
+    _renderer.Begin();
+    _renderer.AddField(&snapshot.field);
+}
+// Lines of info box
+void UserInterfaceWrap::drawInfo(std::vector<std::string>& lines)
+{
+    lines.push_back("[INFO]----------------------------");
+    if (_prepar == nullptr)
+        lines.push_back("Default loaded preset");
+    else
+        lines.push_back("Name: " + _prepar->GetName());
+    lines.push_back("View: row " + std::to_string(_viewport.x) + ", column " + std::to_string(_viewport.y)
+                    + ", zoom " + std::to_string(_viewport.zoom));
+    lines.insert(lines.end(), _messages.begin(), _messages.end());
+    if (_errNo != 0)
+        lines.push_back("[Error No. " + std::to_string(_errNo) + "]:" + _error_msg);
+}
+// Lines of box with user input and help, prompt goes after them
+void UserInterfaceWrap::drawUserInput(std::vector<std::string>& lines, bool help)
+{
+    lines.push_back("[INPUT]---------------------------");
+    if (help)
+    {
+        lines.push_back("Type \"tick\" <n> or \"step\" <n> to pause and advance game on n ticks.");
+        lines.push_back("Type \"run\" to advance game until \"pause\".");
+        lines.push_back("Type \"speed\" <n> to compute at most n ticks per second, 0 - unlimited.");
+        lines.push_back("Type \"dump\" <file> to save state in file.");
+        lines.push_back("Type \"pan\" <rows> <columns> to move view by cells.");
+        lines.push_back("Type \"zoom\" <k> to show k x k cells per character, \"zoom\" to fit field.");
+        lines.push_back("Type \"exit\" to end game.");
+    }
+    else lines.push_back("Type \"help\" to view commands.");
+}
+// Newest snapshot with status line, info and input boxes, written at once
+bool UserInterfaceWrap::drawFrame(const std::string& pending)
+{
+    bool running;
+    long long steps;
+    int gps;
+    {
+        std::lock_guard<std::mutex> lock(_control_mutex);
+        running = _running;
+        steps = _steps;
+        gps = _max_gps;
+    }
+    FrameSnapshot& snapshot = _snapshots.Front();
+    std::vector<std::string> lines;
+    lines.push_back("Generation = " + std::to_string(snapshot.generation)
+        + (running ? "  Running" : "  Paused")
+        + "  Speed = " + (gps > 0 ? std::to_string(gps) + " ticks/s" : std::string("unlimited"))
+        + (steps > 0 ? "  Remained ticks = " + std::to_string(steps) : std::string(""))
+        + "  Bytes/frame = " + std::to_string(_renderer.GetAverageFrameBytes()));
+    drawInfo(lines);
+    drawUserInput(lines, _help);
+
+    // Bottom line of field and prompt are the other lines below the field
+    ViewWindow window = fitViewport(snapshot.n, snapshot.m, (int)lines.size() + 2);
+    if (window.x0 != snapshot.window.x0 || window.x1 != snapshot.window.x1
+        || window.y0 != snapshot.window.y0 || window.y1 != snapshot.window.y1)
+    {
+        std::lock_guard<std::mutex> lock(_control_mutex);
+        _view_request = window;
+        _publish_request = true;
+        _control_cv.notify_one();
+        return false;
+    }
+    drawField(snapshot);
+    for (const std::string& line : lines)
+        _renderer.AddLine(line);
+    _renderer.AddPrompt("Input command: " + pending);
+    _renderer.Flush();
+    return true;
+}
+
+// Whole field in view, smallest zoom that fits it into terminal
+void UserInterfaceWrap::fitView()
+{
+    FrameSnapshot& snapshot = _snapshots.Front();
+    int lines = 0, columns = 0;
+    if (!terminalSize(&lines, &columns))
+    {
+        _viewport = Viewport();
+        return;
+    }
+    lines = std::max(1, lines - UI_RESERVED_LINES);
+    columns = std::max(1, columns - 1);
+    _viewport.x = 0;
+    _viewport.y = 0;
+    _viewport.zoom = std::max(1, std::max((snapshot.n + lines - 1) / lines,
+                                          (snapshot.m + columns - 1) / columns));
+}
+
+// Words of window rows are copied, snapshot field keeps its buffer
+// while size of the window stays the same
+void UserInterfaceWrap::publish()
+{
+    ViewWindow window;
+    {
+        std::lock_guard<std::mutex> lock(_control_mutex);
+        window = _view_request;
+    }
+    Field* field = _logic->GetField();
+    int n = field->getN(), m = field->getM();
+    window.x0 = std::max(0, std::min(window.x0, n - 1));
+    window.y0 = std::max(0, std::min(window.y0, m - 1));
+    window.x1 = std::max(window.x0 + 1, std::min(window.x1, n));
+    window.y1 = std::max(window.y0 + 1, std::min(window.y1, m));
+    size_t first_word = (size_t)window.y0 >> 6;
+    size_t words = (((size_t)window.y1 - 1) >> 6) + 1 - first_word;
+
+    FrameSnapshot& snapshot = _snapshots.Back();
+    snapshot.field.Resize(window.x1 - window.x0,
+                          std::min(m, (int)((first_word + words) * 64)) - (int)(first_word * 64));
+    for (int x = window.x0; x < window.x1; x++)
+        std::memcpy(snapshot.field.getRow(x - window.x0), field->getRow(x) + first_word,
+                    words * sizeof(uint64_t));
+    snapshot.field.markModified();
+    snapshot.window = window;
+    snapshot.n = n;
+    snapshot.m = m;
+    snapshot.generation = _logic->GetGeneration();
+    _snapshots.Publish();
+}
+
+// Only this thread touches logic while Start() runs
+// Every _display_every-th generation and the last one of steps are published
+void UserInterfaceWrap::simulate()
+{
+    auto next_tick = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(_control_mutex);
+    while (!_stop)
+    {
+        // Dump gets the field between two generations, writing is left to I/O thread
+        if (!_dump_requests.empty())
+        {
+            std::vector<std::string> files;
+            files.swap(_dump_requests);
+            _ticking = true;
+            lock.unlock();
+            for (const std::string& file : files)
+                _dumps->Push(_logic->GetField(), _logic->GetGeneration(), file);
+            lock.lock();
+            _ticking = false;
+            continue;
+        }
+        // Viewport moved to cells the drawn snapshot lacks
+        if (_publish_request)
+        {
+            _publish_request = false;
+            _ticking = true;
+            lock.unlock();
+            publish();
+            lock.lock();
+            _ticking = false;
+            continue;
+        }
+        if (!_running && _steps == 0)
+        {
+            _control_cv.wait(lock);
+            next_tick = std::chrono::steady_clock::now();
+            continue;
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (_max_gps > 0 && now < next_tick)
+        {
+            // Woken early by new commands
+            _control_cv.wait_until(lock, next_tick);
+            continue;
+        }
+        if (!_running) _steps--;
+        bool last = !_running && _steps == 0;
+        int gps = _max_gps;
+        _ticking = true;
+        lock.unlock();
+
+        _logic->Tick();
+        if (last || _logic->GetGeneration() % _display_every == 0)
+            publish();
+        // Late generations are not caught up by a burst
+        if (gps > 0)
+            next_tick = std::max(next_tick + std::chrono::nanoseconds(1000000000LL / gps), now);
+
+        lock.lock();
+        _ticking = false;
+    }
+}
+
+// Continuous run is not waited for, it goes on until paused
+bool UserInterfaceWrap::stepsDone()
+{
+    std::lock_guard<std::mutex> lock(_control_mutex);
+    return _steps == 0 && _dump_requests.empty() && (_running || !_ticking);
+}
+
+void UserInterfaceWrap::parseUInput(std::string line)
+{
+    // Errors, help and messages stay on screen until the next command
+    _errNo = 0;
+    _help = false;
+    _messages.clear();
+    std::string word = getword(line);
+    if (word == std::string("dump"))
+    {
+        if (line.size() > 5)
+        {
+            std::string arg = line.substr(5);
+            std::lock_guard<std::mutex> lock(_control_mutex);
+            _dump_requests.push_back(arg);
+        }
+        else
+        {
+            _errNo = 2;
+            _error_msg = std::string("Command \"dump\" requires argument");
+        }
+    }
+    else if (word == std::string("tick") || word == std::string("step"))
+    {
+        long long ticks = 1;
+        if (line.size() > 4)
         {
-            if (line.size() > 4)
+            std::string arg = line.substr(5);
+            try
             {
-                std::string arg = line.substr(5);
-                try
-                {
-                    _ticks = std::stoi(arg);
-                }
-                catch (const std::exception&)
-                {
-                    _errNo = 1;
-                    _error_msg = std::string("Invalid argument for \"tick\": ") + std::string(arg);
-                    _ticks = 0;
-                }
+                ticks = std::stoll(arg);
+                if (ticks < 0) throw std::invalid_argument("negative");
             }
-            else
+            catch (const std::exception&)
             {
-                _ticks = 1;
+                _errNo = 1;
+                _error_msg = std::string("Invalid argument for \"") + word + "\": " + std::string(arg);
+                ticks = 0;
             }
         }
-        else if (word == std::string("exit"))
+        std::lock_guard<std::mutex> lock(_control_mutex);
+        _running = false;
+        _steps += ticks;
+    }
+    else if (word == std::string("run") || word == std::string("pause"))
+    {
+        std::lock_guard<std::mutex> lock(_control_mutex);
+        _running = word == std::string("run");
+        _steps = 0;
+    }
+    else if (word == std::string("speed"))
+    {
+        std::string arg = line.size() > 5 ? line.substr(6) : std::string("");
+        try
+        {
+            int gps = std::stoi(arg);
+            if (gps < 0) throw std::invalid_argument("negative");
+            std::lock_guard<std::mutex> lock(_control_mutex);
+            _max_gps = gps;
+        }
+        catch (const std::exception&)
+        {
+            _errNo = 7;
+            _error_msg = std::string("Invalid argument for \"speed\": ") + arg;
+        }
+    }
+    else if (word == std::string("pan"))
+    {
+        std::istringstream args(line.size() > 3 ? line.substr(4) : std::string(""));
+        int dx, dy;
+        if (args >> dx >> dy)
+        {
+            _viewport.x = (int)std::max<long long>(0, std::min<long long>(INT_MAX, (long long)_viewport.x + dx));
+            _viewport.y = (int)std::max<long long>(0, std::min<long long>(INT_MAX, (long long)_viewport.y + dy));
+        }
+        else
+        {
+            _errNo = 5;
+            _error_msg = std::string("Command \"pan\" requires two numbers");
+        }
+    }
+    else if (word == std::string("zoom"))
+    {
+        if (line.size() > 4)
         {
-            if (line.size() > 4)
+            std::string arg = line.substr(5);
+            try
             {
-                _errNo = 4;
-                _error_msg = std::string("Command \"exit\" takes no arguments");
+                int zoom = std::stoi(arg);
+                if (zoom < 1) throw std::invalid_argument("not positive");
+                _viewport.zoom = zoom;
             }
-            else
+            catch (const std::exception&)
             {
-                std::cout << "Closing game." << std::endl;
-                exit(0);
+                _errNo = 6;
+                _error_msg = std::string("Invalid argument for \"zoom\": ") + arg;
             }
         }
-        else if (word == std::string("help"))
+        else
+            fitView();
+    }
+    else if (word == std::string("exit"))
+    {
+        if (line.size() > 4)
         {
-            _help = true;
-            if (line.size() > 4)
-            {
-                _errNo = 3;
-                _error_msg = std::string("Command \"help\" takes no arguments");
-            }
+            _errNo = 4;
+            _error_msg = std::string("Command \"exit\" takes no arguments");
         }
+        else
+            _exit = true;
     }
-
-public:
-    UserInterfaceWrap(ModeSelector* mode, std::string inputFile, std::string outputFile = std::string(""), int offlineTicks = 0)
+    else if (word == std::string("help"))
     {
-        std::cout << "Loading..." << std::endl;
-        setMode(mode, inputFile, outputFile, offlineTicks);
-        std::cout << "Complete." << std::endl;
+        _help = true;
+        if (line.size() > 4)
+        {
+            _errNo = 3;
+            _error_msg = std::string("Command \"help\" takes no arguments");
+        }
     }
+    _control_cv.notify_one();
+}
+
+static ModeContext fileContext(std::string inputFile, std::string outputFile, int offlineTicks)
+{
+    ModeContext context;
+    context.inputFile = inputFile;
+    context.outputFile = outputFile;
+    context.offline_ticks = offlineTicks;
+    return context;
+}
+
+UserInterfaceWrap::UserInterfaceWrap(ModeSelector* mode, std::string inputFile, std::string outputFile, int offlineTicks)
+    : UserInterfaceWrap(mode, fileContext(inputFile, outputFile, offlineTicks))
+{
+}
 
-    void Start()
+UserInterfaceWrap::UserInterfaceWrap(ModeSelector* mode, ModeContext context)
+{
+    std::cout << "Loading..." << std::endl;
+    setMode(mode, context);
+    _renderer.SetGlyphs(context.glyphs);
+    _renderer.SetDiff(context.diff_frames);
+    _fps = context.fps;
+    _max_gps = context.max_gps;
+    _display_every = context.display_every;
+    std::cout << "Complete." << std::endl;
+}
+
+// Commands are read while the game runs: the simulation thread computes
+// generations, this thread draws the newest of them _fps times per second
+// and whenever typed text changes.
+// Lines of a terminal take effect at once, lines of piped input
+// one by one when the previous ones are done, like a script
+void UserInterfaceWrap::Start()
+{
+    _dumps.reset(new DumpQueue(_prepar));
+    _messages = _logic->TakeMessages();
+    publish();
+    _snapshots.Update();
+    std::thread simulation(&UserInterfaceWrap::simulate, this);
     {
-        while (true)
+        ConsoleInput input;
+        std::deque<std::string> commands;
+        auto frame_time = std::chrono::microseconds(1000000 / _fps);
+        auto next_frame = std::chrono::steady_clock::now();
+        bool redraw = true;
+        while (!_exit)
         {
-            std::string input_line;
-
-            ticks();
-            CLEAR_SCREEN
-            drawField();
-            drawInfo();
-            if (!_dump_file.empty())
-                dumpFile();
-            _logic->PrintMessages();
-            drawUserInput(_help);
-            _help = false;
+            auto now = std::chrono::steady_clock::now();
+            int wait_ms = now < next_frame
+                ? (int)std::chrono::duration_cast<std::chrono::milliseconds>(next_frame - now).count() + 1 : 0;
+            std::vector<std::string> lines;
+            if (input.Poll(wait_ms, lines))
+                redraw = true;
+            commands.insert(commands.end(), lines.begin(), lines.end());
+            while (!commands.empty() && !_exit && (input.IsTerminal() || stepsDone()))
+            {
+                parseUInput(commands.front());
+                commands.pop_front();
+                redraw = true;
+            }
+            // Script is over once its lines are done
+            if (input.AtEof() && commands.empty() && stepsDone())
+                _exit = true;
+            for (const std::string& result : _dumps->TakeResults())
+            {
+                _messages.push_back(result);
+                redraw = true;
+            }
 
-            std::getline(std::cin, input_line);
-            parseUInput(input_line);
+            now = std::chrono::steady_clock::now();
+            if (now >= next_frame)
+            {
+                if (_snapshots.Update())
+                    redraw = true;
+                next_frame = std::max(next_frame + frame_time, now);
+            }
+            // Frame waits for snapshot of a moved viewport
+            if (redraw && drawFrame(input.GetPending()))
+                redraw = false;
         }
-        
     }
 
-    void DrawAll()
     {
-        drawField();
-        drawInfo();
-        drawUserInput();
+        std::lock_guard<std::mutex> lock(_control_mutex);
+        _stop = true;
+    }
+    _control_cv.notify_one();
+    simulation.join();
+    // Queued dumps are written before closing
+    _dumps->Wait();
+    std::cout << std::endl;
+    for (const std::string& result : _dumps->TakeResults())
+        std::cout << result << std::endl;
+    _dumps.reset();
+    std::cout << "Closing game." << std::endl;
+}
+
+void UserInterfaceWrap::DrawAll()
+{
+    publish();
+    _snapshots.Update();
+    // Window of viewport is known after the first try
+    if (!drawFrame(""))
+    {
+        publish();
+        _snapshots.Update();
+        drawFrame("");
     }
+    std::cout << std::endl;
+}
 
-};
+#pragma endregion
 
 #pragma region StolenParser
 
@@ -721,6 +2424,49 @@ bool cmdOptionExists(char** begin, char** end, const std::string& option)
     return std::find(begin, end, option) != end;
 }
 
+// Integer value of option, at least min
+// Prints usage and exits if the value is missing or wrong
+static int intOption(char** argv, int argc, const std::string& option, int min, const std::string& usage)
+{
+    char* res = getCmdOption(argv, argv + argc, option);
+    try
+    {
+        if (res == NULL) throw std::invalid_argument("no value");
+        int value = std::stoi(std::string(res));
+        if (value < min) throw std::invalid_argument("too small");
+        return value;
+    }
+    catch (const std::exception&)
+    {
+        std::cout << "Incorrect usage." << std::endl;
+        std::cout << usage << std::endl;
+        exit(1);
+    }
+}
+
+// First argument that is neither an option nor value of an option, NULL if none
+static char* plainArgument(int argc, char** argv)
+{
+    static const char* const value_options[] = {
+        "-t", "-o", "-i", "-p", "-e", "--glyphs", "--fps", "--max-gps", "--display-every",
+        "--batch", "--soups", "--checkpoint-every", "--resume", "--metrics", "--metrics-every"
+    };
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-' || argv[i][1] == '\0')
+            return argv[i];
+        for (const char* option : value_options)
+        {
+            if (std::strcmp(argv[i], option) == 0)
+            {
+                i++;
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
 #pragma endregion
 
 int Play(int argc, char* argv[])
@@ -728,26 +2474,145 @@ int Play(int argc, char* argv[])
     ModeSelector* mode = NULL;
     std::string file = std::string("");
     std::string out_file = std::string("");
-    int offl_iterations = 0;
+    ModeContext context;
     char* res;
-    if (argc == 1)
+
+    // Number of threads can be added to any mode
+    int plain_argc = argc;
+    if (cmdOptionExists(argv, argv + argc, "-t"))
+    {
+        res = getCmdOption(argv, argv + argc, "-t");
+        try
+        {
+            if (res == NULL) throw std::invalid_argument("no value");
+            context.threads = std::stoi(std::string(res));
+            if (context.threads < 1) throw std::invalid_argument("not positive");
+        }
+        catch (const std::exception&)
+        {
+            std::cout << "Incorrect usage." << std::endl;
+            std::cout << "Specify positive number of threads (-t <threads>)" << std::endl;
+            exit(1);
+        }
+        plain_argc -= 2;
+    }
+
+    // Glyphs of interactive frames
+    if (cmdOptionExists(argv, argv + argc, "--glyphs"))
+    {
+        res = getCmdOption(argv, argv + argc, "--glyphs");
+        if (res == NULL || !glyphModeFromName(std::string(res), &context.glyphs))
+        {
+            std::cout << "Incorrect usage." << std::endl;
+            std::cout << "Specify glyphs: ascii, half or braille (--glyphs <glyphs>)" << std::endl;
+            exit(1);
+        }
+        plain_argc -= 2;
+    }
+    if (cmdOptionExists(argv, argv + argc, "--diff"))
+    {
+        context.diff_frames = true;
+        plain_argc -= 1;
+    }
+    // Pacing of interactive run
+    if (cmdOptionExists(argv, argv + argc, "--fps"))
+    {
+        context.fps = intOption(argv, argc, "--fps", 1, "Specify positive frames per second (--fps <n>)");
+        plain_argc -= 2;
+    }
+    if (cmdOptionExists(argv, argv + argc, "--max-gps"))
+    {
+        context.max_gps = intOption(argv, argc, "--max-gps", 0, "Specify generations per second, 0 - unlimited (--max-gps <n>)");
+        plain_argc -= 2;
+    }
+    if (cmdOptionExists(argv, argv + argc, "--display-every"))
+    {
+        context.display_every = intOption(argv, argc, "--display-every", 1, "Specify positive number of generations (--display-every <n>)");
+        plain_argc -= 2;
+    }
+
+    if (cmdOptionExists(argv, argv + argc, "--batch")
+        || cmdOptionExists(argv, argv + argc, "--soups"))
+    {
+        mode = new BatchMode();
+        res = getCmdOption(argv, argv + argc, "-o");
+        if (res == NULL || res[0] == '-')
+        {
+            std::cout << "Incorrect usage." << std::endl;
+            std::cout << "Specify results file (-o <filename>)" << std::endl;
+            exit(1);
+        }
+        out_file = std::string(res);
+
+        if (cmdOptionExists(argv, argv + argc, "--batch"))
+        {
+            res = getCmdOption(argv, argv + argc, "--batch");
+            if (res == NULL || res[0] == '-')
+            {
+                std::cout << "Incorrect usage." << std::endl;
+                std::cout << "Specify directory or manifest of presets (--batch <path>)" << std::endl;
+                exit(1);
+            }
+            context.batchSource = std::string(res);
+        }
+        else
+        {
+            res = getCmdOption(argv, argv + argc, "--soups");
+            try
+            {
+                if (res == NULL) throw std::invalid_argument("no value");
+                std::string range(res);
+                size_t colon = range.find(':');
+                if (colon == std::string::npos) throw std::invalid_argument("no range");
+                context.seed_first = std::stoull(range.substr(0, colon));
+                context.seed_last = std::stoull(range.substr(colon + 1));
+                if (context.seed_first > context.seed_last) throw std::invalid_argument("empty range");
+            }
+            catch (const std::exception&)
+            {
+                std::cout << "Incorrect usage." << std::endl;
+                std::cout << "Specify seed range (--soups <first>:<last>)" << std::endl;
+                exit(1);
+            }
+        }
+
+        if (cmdOptionExists(argv, argv + argc, "-i"))
+        {
+            res = getCmdOption(argv, argv + argc, "-i");
+            try
+            {
+                if (res == NULL) throw std::invalid_argument("no value");
+                context.offline_ticks = std::stoll(std::string(res));
+                if (context.offline_ticks < 1) throw std::invalid_argument("not positive");
+            }
+            catch (const std::exception&)
+            {
+                std::cout << "Incorrect usage." << std::endl;
+                std::cout << "Specify generation limit of a board (-i <n>)" << std::endl;
+                exit(1);
+            }
+        }
+    }
+    else if (plain_argc == 1)
         mode = new DefaultMode();
-    else if (argc == 2)
+    else if (plain_argc == 2 && plainArgument(argc, argv) != NULL)
     {
         mode = new LoadFileMode();
-        file = std::string(argv[1]);
+        file = std::string(plainArgument(argc, argv));
     }
     else
     {
         if (cmdOptionExists(argv, argv + argc, "-o")
-            && cmdOptionExists(argv, argv + argc, "-i"))
+            && (cmdOptionExists(argv, argv + argc, "-i")
+                || cmdOptionExists(argv, argv + argc, "-p"))
+            && plainArgument(argc, argv) != NULL)
         {
             mode = new OfflineMode();
-            file = std::string(argv[1]);
+            file = std::string(plainArgument(argc, argv));
 
             res = getCmdOption(argv, argv + argc, "-o");
            
-            if (res == NULL || std::string("-i") == std::string(res))
+            if (res == NULL || res[0] == '-')
             {
                 std::cout << "Incorrect usage." << std::endl;
                 std::cout << "Specify output file (-o <filename>)" << std::endl;
@@ -755,18 +2620,130 @@ int Play(int argc, char* argv[])
             }
             out_file = std::string(res);
 
+            if (cmdOptionExists(argv, argv + argc, "--checkpoint-every"))
+            {
+                res = getCmdOption(argv, argv + argc, "--checkpoint-every");
+                try
+                {
+                    if (res == NULL) throw std::invalid_argument("no value");
+                    context.checkpoint_every = std::stoll(std::string(res));
+                    if (context.checkpoint_every < 1) throw std::invalid_argument("not positive");
+                }
+                catch (const std::exception&)
+                {
+                    std::cout << "Incorrect usage." << std::endl;
+                    std::cout << "Specify positive checkpoint period (--checkpoint-every <n>)" << std::endl;
+                    exit(1);
+                }
+            }
+
+            if (cmdOptionExists(argv, argv + argc, "--no-cycles"))
+                context.detect_cycles = false;
+
+            if (cmdOptionExists(argv, argv + argc, "--metrics"))
+            {
+                res = getCmdOption(argv, argv + argc, "--metrics");
+                if (res == NULL || res[0] == '-')
+                {
+                    std::cout << "Incorrect usage." << std::endl;
+                    std::cout << "Specify metrics file (--metrics <file>)" << std::endl;
+                    exit(1);
+                }
+                context.metricsFile = std::string(res);
+            }
+
+            if (cmdOptionExists(argv, argv + argc, "--metrics-every"))
+            {
+                res = getCmdOption(argv, argv + argc, "--metrics-every");
+                try
+                {
+                    if (res == NULL) throw std::invalid_argument("no value");
+                    context.metrics_every = std::stoll(std::string(res));
+                    if (context.metrics_every < 1) throw std::invalid_argument("not positive");
+                }
+                catch (const std::exception&)
+                {
+                    std::cout << "Incorrect usage." << std::endl;
+                    std::cout << "Specify positive metrics period (--metrics-every <n>)" << std::endl;
+                    exit(1);
+                }
+            }
+
+            if (cmdOptionExists(argv, argv + argc, "--resume"))
+            {
+                res = getCmdOption(argv, argv + argc, "--resume");
+                if (res == NULL || res[0] == '-')
+                {
+                    std::cout << "Incorrect usage." << std::endl;
+                    std::cout << "Specify checkpoint file (--resume <file>)" << std::endl;
+                    exit(1);
+                }
+                context.resumeFile = std::string(res);
+            }
+
+            if (cmdOptionExists(argv, argv + argc, "-e"))
+            {
+                res = getCmdOption(argv, argv + argc, "-e");
+                if (res != NULL && std::string("hashlife") == std::string(res))
+                    context.engine = OFFLINE_HASHLIFE;
+                else if (res != NULL && std::string("sparse") == std::string(res))
+                    context.engine = OFFLINE_SPARSE;
+                else if (res != NULL && std::string("field") == std::string(res))
+                    context.engine = OFFLINE_FIELD;
+                else
+                {
+                    std::cout << "Incorrect usage." << std::endl;
+                    std::cout << "Specify engine (-e field | -e hashlife | -e sparse)" << std::endl;
+                    exit(1);
+                }
+            }
+
+            // Only the field engine checkpoints, writes metrics and looks for cycles
+            if (context.engine != OFFLINE_FIELD)
+            {
+                const char* fieldOnly[] = { "--checkpoint-every", "--resume", "--metrics", "--metrics-every", "--no-cycles" };
+                for (const char* option : fieldOnly)
+                {
+                    if (!cmdOptionExists(argv, argv + argc, option)) continue;
+                    std::cout << "Incorrect usage." << std::endl;
+                    std::cout << "Option " << option << " works only with -e field" << std::endl;
+                    exit(1);
+                }
+            }
+
+            if (cmdOptionExists(argv, argv + argc, "-p"))
+            {
+                res = getCmdOption(argv, argv + argc, "-p");
+                try
+                {
+                    if (res == NULL) throw std::invalid_argument("no value");
+                    context.step_pow2 = std::stoi(std::string(res));
+                    if (context.step_pow2 < 0 || context.step_pow2 > 59)
+                        throw std::invalid_argument("out of range");
+                }
+                catch (const std::exception&)
+                {
+                    std::cout << "Incorrect usage." << std::endl;
+                    std::cout << "Specify power of two from 0 to 59 (-p <k>)" << std::endl;
+                    exit(1);
+                }
+            }
+            else
             {
                 res = getCmdOption(argv, argv + argc, "-i");
-                if (res == NULL)
+                try
+                {
+                    if (res == NULL) throw std::invalid_argument("no value");
+                    context.offline_ticks = std::stoll(std::string(res));
+                    if (context.offline_ticks < 0) throw std::invalid_argument("negative");
+                }
+                catch (const std::exception&)
                 {
                     std::cout << "Incorrect usage." << std::endl;
                     std::cout << "Specify iterations number (-i <n>)" << std::endl;
                     exit(1);
                 }
             }
-            std::string iters = std::string(res);
-
-            offl_iterations = std::stoi(iters);
         }
         else
         {
@@ -774,11 +2751,30 @@ int Play(int argc, char* argv[])
             std::cout << "Default mode: no arguments" << std::endl;
             std::cout << "Load file mode: <filename>" << std::endl;
             std::cout << "Offline mode: <filename> -o <outputfile> -i <number>" << std::endl;
+            std::cout << "              -p <k> instead of -i runs 2^k iterations" << std::endl;
+            std::cout << "              -e hashlife runs HashLife over unbounded plane" << std::endl;
+            std::cout << "              -e sparse runs chunked sparse field over unbounded plane" << std::endl;
+            std::cout << "              --checkpoint-every <n> saves <outputfile>.checkpoint.snap every n iterations" << std::endl;
+            std::cout << "              --resume <checkpoint> continues interrupted run up to iteration <number>" << std::endl;
+            std::cout << "              --no-cycles computes every iteration even if the field repeats itself" << std::endl;
+            std::cout << "              --metrics <file> writes tick stats as JSON lines, or Prometheus text for .prom" << std::endl;
+            std::cout << "              --metrics-every <n> writes stats every n iterations, 1000 by default" << std::endl;
+            std::cout << "Batch mode: --batch <directory|manifest> -o <resultsfile> [-i <limit>]" << std::endl;
+            std::cout << "            --soups <first>:<last> instead of --batch runs random soups of seeds" << std::endl;
+            std::cout << "Any mode: -t <threads> to run simulation on several threads" << std::endl;
+            std::cout << "          --glyphs ascii|half|braille draws 1, 2 or 8 cells per character" << std::endl;
+            std::cout << "          --diff redraws only changed cells of interactive frames" << std::endl;
+            std::cout << "          --fps <n> draws n frames per second, " << DEFAULT_FPS << " by default" << std::endl;
+            std::cout << "          --max-gps <n> computes at most n generations per second, 0 - unlimited, "
+                      << DEFAULT_MAX_GPS << " by default" << std::endl;
+            std::cout << "          --display-every <n> draws only every n-th generation" << std::endl;
             return 1;
         }
     }
     if (mode == NULL) mode = new DefaultMode();
-    UserInterfaceWrap* UI = new UserInterfaceWrap(mode, file, out_file, offl_iterations);
+    context.inputFile = file;
+    context.outputFile = out_file;
+    UserInterfaceWrap* UI = new UserInterfaceWrap(mode, context);
     UI->Start();
     return 0;
-}
+}
\ No newline at end of file
@@ -1,13 +1,60 @@
 #pragma once
 #include <string>
+#include <iosfwd>
 #include <vector>
 #include <queue>
 #include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include "PackedKernels.h"
+#include "ThreadPool.h"
+#include "HashLife.h"
+#include "SparseField.h"
+#include "Snapshot.h"
+#include "Metrics.h"
+#include "Renderer.h"
+#include "TripleBuffer.h"
 
 std::string getword(std::string line);
+// Bit mask of digits in B/S integer: bit k is set if k is a digit
+// 0 must NOT be first digit of integer
+uint16_t digitMask(int digits);
+// Bit mask of digits in B/S string, e.g. "023"
+// Returns false if string is not a list of digits 0..8
+bool digitMask(std::string digits, uint16_t* mask);
+// Digits of mask in ascending order
+std::string maskDigits(uint16_t mask);
 
+/// <summary>
+///  Field class, contains information about cells.
+///  Supports get, set by coords(x,y) and draw field in console
+///
+///  Cells are bit-packed: 64 cells of a row per uint64_t word,
+///  bit (y % 64) of word (y / 64) holds cell (x, y).
+///  All rows live in one contiguous buffer aligned to FIELD_ALIGNMENT,
+///  each row is padded to a multiple of FIELD_ALIGNMENT bytes.
+///  Padding bits are always kept zero.
+/// </summary>
 class Field
 {
+private:
+    uint64_t* _words = nullptr;
+    int n = 0, m = 0;
+    // Words used by cells in every row
+    size_t _row_words = 0;
+    // Words between starts of two neighbour rows
+    size_t _stride = 0;
+    // Changed by every modification of cells
+    uint64_t _version = 0;
+
+    // Initialize field NxM
+    void createField(int _n, int _m);
+    void freeField();
+
 public:
 #pragma region Constructors
 
@@ -15,8 +62,16 @@ public:
     Field();
     // Field with size = NxM
     Field(int n, int m);
+    Field(const Field& other);
+    Field& operator=(const Field& other);
+    ~Field();
 #pragma endregion
 
+    // Exchanges cells with other field of the same size
+    void Swap(Field& other);
+    // Changes size to NxM, all cells are cleared
+    void Resize(int n, int m);
+
     void DefaultPreset();
     void Clear();
     void Draw();
@@ -38,21 +93,107 @@ public:
     bool getAt(int x, int y);
     void setAt(int x, int y, bool val);
 
+#pragma endregion
+
+#pragma region PackedStorage
+
+    // Raw access to packed rows for word-parallel code
+    // Row x (0 <= x < N) starts at getRow(x) and holds getRowWords() words,
+    // bits past M in the last word are zero and must stay zero
+
+    size_t getRowWords();
+    size_t getStride();
+    uint64_t* getRow(int x);
+    // Mask of bits used by cells in the last word of a row
+    uint64_t getLastWordMask();
+    // Counter of modifications, lets Logic notice cells set from outside
+    // Code writing through getRow() must call markModified()
+    uint64_t getVersion();
+    void markModified();
+    // Cell buffers allocated by all fields of the process since start,
+    // Logic stats count only buffers of their own logic
+    static uint64_t GetAllocations();
+    // True if other field has the same size and cells
+    bool Equals(Field& other);
+
 #pragma endregion
 };
 
+// Struct that represents cell operation
+// Means: "set <val> at <x,y>"
 typedef struct CellOp_s
 {
     int x, y;
     bool val;
 } CellOp;
 
+// File formats of presets
+// FORMAT_NATIVE    - name line, #N comment, #R rule and "<row> <column>" cell lines
+// FORMAT_LIFE106   - "#Life 1.06" header, #D/#R lines and "<column> <row>" cell lines
+// FORMAT_RLE       - run length encoded rows, "x = m, y = n, rule = B3/S23" header
+// FORMAT_PLAINTEXT - rows of '.' and 'O', lines starting with '!' are comments
+// FORMAT_SNAPSHOT  - binary snapshot, see Snapshot.h
+// Format is chosen by extension (.lif/.life, .rle, .cells, .snap),
+// files with other extensions are recognized by their first lines,
+// native format is the default
+enum PresetFormat
+{
+    FORMAT_NATIVE,
+    FORMAT_LIFE106,
+    FORMAT_RLE,
+    FORMAT_PLAINTEXT,
+    FORMAT_SNAPSHOT
+};
+
 /// <summary>
 /// This class is used as a part of the logic
 /// to read and parse files with presets
 /// </summary>
 class PresetParser
 {
+private:
+    std::string _inputFile;
+
+    std::string _presetName = std::string("Default loaded preset");
+    std::string _presetComment = std::string("...");
+    int b = 3, s = 23;
+    // Generation stored in snapshot, 0 for text presets
+    uint64_t _generation = 0;
+    // Rule as digit masks: bit k is set if k neighbours give birth/survival
+    uint16_t _b_mask = 1 << 3, _s_mask = (1 << 2) | (1 << 3);
+    bool parsed = false;
+
+    // Choosing a parser for parameter string
+    // marked with # at the beginning of the line
+    // Returns true if parameter is recognized and parsed
+    // false - otherwise
+    bool parseParameter(std::string line);
+    // Parser for R parameter
+    bool parseR(std::string line);
+    // Sets rule from "B3/S23" or "23/3" (S/B) notation
+    // Returns false if rule is not recognized
+    bool parseRule(std::string rule);
+    // Parser for N parameter
+    bool parseN(std::string line);
+    // Parser for active cell line [begin, end), "<x> <y>"
+    bool parseCell(const char* begin, const char* end, int* x, int* y);
+    // Format of file by extension, or by contents [data, data + size)
+    PresetFormat detectFormat(const char* data, size_t size);
+    // Parses memory-mapped input file, calls visit(x, y) for every active cell
+    template <class CellVisitor>
+    void parseMapped(CellVisitor visit);
+    // Parsers of text formats over [p, end)
+    template <class CellVisitor>
+    void parseNative(const char* p, const char* end, CellVisitor& visit);
+    template <class CellVisitor>
+    void parseLife106(const char* p, const char* end, CellVisitor& visit);
+    template <class CellVisitor>
+    void parseRle(const char* p, const char* end, CellVisitor& visit);
+    template <class CellVisitor>
+    void parsePlaintext(const char* p, const char* end, CellVisitor& visit);
+    // Writes name, comment and B/S lines of native or Life 1.06 dump
+    void dumpHeader(std::ostream& out, bool life106);
+
 public:
     PresetParser(char* str);
     PresetParser(std::string str);
@@ -66,21 +207,213 @@ public:
     // Note that this parameters are stored inside this class
     // and needs to be read separately from queue
     void Parse(std::queue<CellOp*>* ops_q);
+    // Same as Parse, but active cells are set straight into field,
+    // no operation is allocated per cell
+    // Snapshot is loaded whole, field is resized to its size
+    // Returns number of cells listed more than once
+    long long Load(Field* field);
+    // Same as Parse, but visit(x, y) is called for every active cell,
+    // no operation is allocated per cell
+    template <class CellVisitor>
+    void ForEachCell(CellVisitor visit);
+    PresetFormat GetFormat();
+    // True if input file is binary snapshot (see Snapshot.h)
+    bool IsSnapshot();
+    void LoadSnapshot(Field* field);
+    void SaveSnapshot(Field* field, std::string output, uint64_t generation, bool compress = true);
+    // Saves field in format chosen by extension of output
+    // (see PresetFormat), native dump for unknown extensions
+    void Save(Field* field, std::string output, uint64_t generation = 0);
+    void DumpRle(Field* field, std::string output);
+    void DumpPlaintext(Field* field, std::string output);
+    // Dump writes Life 1.06 to .lif/.life files, native format to others
     void Dump(std::queue<CellOp*>* ops_q, std::string output);
+    // Dumps live cells straight from packed rows of field, no queue is built
+    void Dump(Field* field, std::string output);
+    // Dumps live cells of HashLife universe, coordinates are 64-bit
+    void Dump(HashLife* universe, std::string output);
+    // Dumps live cells of sparse field, coordinates are 64-bit
+    void Dump(SparseField* field, std::string output);
 
+    // B/S as integers, leading 0 of B0 rules is lost, use masks instead
     int GetB();
     int GetS();
+    uint16_t GetBMask();
+    uint16_t GetSMask();
+    uint64_t GetGeneration();
 
     std::string GetComment();
     std::string GetName();
 };
 
+// Algorithm used by Logic::Tick()
+// ENGINE_SCALAR - per-cell neighbour sums (reference)
+// ENGINE_SWAR   - word-parallel bit-sliced adders over packed rows,
+//                 row kernel is picked by CPU features (see PackedKernels.h)
+enum TickEngine
+{
+    ENGINE_SCALAR,
+    ENGINE_SWAR
+};
+
+// Order in which Logic::Tick() computes the field
+// SCHEDULE_BANDS - every thread takes a horizontal band of rows
+// SCHEDULE_TILES - field is split into tiles of TILE_ROWS x TILE_WORDS words,
+//                  only tiles changed by previous tick and their neighbours
+//                  are computed, still lifes and empty space are skipped,
+//                  threads balance tiles by work stealing (ENGINE_SWAR only)
+enum TickSchedule
+{
+    SCHEDULE_BANDS,
+    SCHEDULE_TILES
+};
+
 /// <summary>
 /// Performs all operations over cells and updates state
 /// of the game by Tick()
 /// </summary>
 class Logic
 {
+private:
+    Field* _field_ptr;
+    // Rule compiled into masks: bit k is set if k neighbours give birth/survival
+    uint16_t _b_mask = 0, _s_mask = 0;
+    std::vector<std::string> load_messages;
+    TickEngine _engine = ENGINE_SWAR;
+    // Row kernel of ENGINE_SWAR, best for CPU by default
+    KernelIsa _kernel_isa = KERNEL_SCALAR;
+    PackedRowKernel _kernel = nullptr;
+    PackedRowCount _row_count = nullptr;
+
+    // Next generation is built here and swapped with the field
+    Field* _back_ptr = nullptr;
+    // Workers of multithreaded tick, nullptr for single thread
+    ThreadPool* _pool = nullptr;
+    TickSchedule _schedule = SCHEDULE_BANDS;
+
+#pragma region TileState
+
+    WorkStealingScheduler _scheduler;
+    int _tile_rows = 0, _tile_cols = 0;
+    // Tiles changed by the last tick and tiles changed by current one
+    std::vector<int> _changed_tiles, _next_changed_tiles;
+    // Changed tiles found by every worker during tick
+    std::vector<std::vector<int>> _worker_changed_tiles;
+    // Tiles computed in this tick, _tile_stamp[t] == _tile_round if scheduled
+    std::vector<int> _scheduled_tiles;
+    std::vector<uint32_t> _tile_stamp;
+    uint32_t _tile_round = 0;
+    // Tile lists are valid for this field in this version with this rule
+    bool _tiles_valid = false;
+    // Tile lists were just rebuilt, back buffer is empty
+    bool _tiles_fresh = false;
+    Field* _tiles_field = nullptr;
+    uint64_t _tiles_version = 0;
+    uint16_t _tiles_b_mask = 0, _tiles_s_mask = 0;
+    // Tiles computed and skipped by the last tick
+    long long _tiles_evaluated = 0, _tiles_skipped = 0;
+
+#pragma endregion
+
+    // Generations passed since preset, counted by Tick()
+    uint64_t _generation = 0;
+
+#pragma region StateHash
+
+    // Hash of every tile (TILE_ROWS x TILE_WORDS), state hash is XOR of them
+    std::vector<uint64_t> _tile_hash;
+    uint64_t _state_hash = 0;
+    // Tile hashes are valid for this field in this version
+    bool _hash_valid = false;
+    Field* _hash_field = nullptr;
+    uint64_t _hash_version = 0;
+
+    // Tiled tick updates hashes of changed tiles only
+    void updateStateHash(uint64_t version_before);
+
+#pragma endregion
+
+#pragma region Stats
+
+    bool _stats_enabled = false;
+    TickStats _stats;
+    LatencyHistogram _tick_latency;
+
+    // Births and deaths between back buffer (previous generation) and field in rows/words range
+    void countChanges(int x0, int x1, size_t w0, size_t w1, uint64_t& births, uint64_t& deaths);
+    // Updates counters after tick
+    void recordTick(uint64_t ns);
+
+#pragma endregion
+
+#pragma region CellSummary
+
+    // Live cells of rows or of a tile and their extent,
+    // min > max if there are none
+    typedef struct CellSummary_s
+    {
+        uint64_t population = 0;
+        int min_x = INT_MAX, min_y = INT_MAX;
+        int max_x = -1, max_y = -1;
+    } CellSummary;
+
+    // Rows summarized by band ticks right after the kernel wrote them
+    std::vector<CellSummary> _row_summary;
+    // Tiles summarized by tiled ticks, only changed tiles are summarized again
+    std::vector<CellSummary> _tile_summary;
+    bool _tile_summary_valid = false;
+    // Tiles changed by current tiled tick are summarized by stepTile()
+    bool _summary_in_tiles = false;
+    // Set by the first GetPopulation() or GetBoundingBox(), ticks keep summary from then on
+    bool _summary_tracking = false;
+    // Summary of the whole field, valid for this field in this version
+    CellSummary _summary;
+    bool _summary_valid = false;
+    Field* _summary_field = nullptr;
+    uint64_t _summary_version = 0;
+
+    CellSummary summarize(Field* field, int x0, int x1, size_t w0, size_t w1);
+    static void mergeSummary(CellSummary& into, const CellSummary& part);
+    // Whole field summarized tile by tile
+    void summarizeField();
+    // Summary after tick from rows or changed tiles
+    void updateSummary(bool tiled);
+
+#pragma endregion
+
+    // Sum of active neighbours for cell at (x,y)
+    int activeCellSum(int x, int y);
+    // Check sum of neighbour active cells for birth
+    // If s == true, it checks S (survival) instead
+    // For S better use checkS(sum)
+    bool checkB(int sum, bool check_s = false);
+    // Check sum of neighbour active cells for survival
+    bool checkS(int sum);
+    // Scans rows [from, to) of field and writes next iteration
+    // of every cell into back buffer
+    void scanField(int from, int to);
+
+    // For debug. Prints map of active neighbours
+    void printCellSums();
+
+    // Back buffer of the same size as the field
+    void prepareBackBuffer();
+    // Next generation of rows [from, to) computed word by word over packed rows
+    void tickPacked(int from, int to);
+    // Next generation of rows [from, to) by selected engine
+    void stepRows(int from, int to);
+    // Rows of band processed by worker of thread pool
+    void stepBand(int worker);
+
+    bool tileHasCells(Field* field, int tile);
+    // Rebuilds tile grid and tile lists if field was changed outside
+    void prepareTiles();
+    void scheduleTile(int tile_row, int tile_col);
+    void stepTile(int tile, int worker);
+    void runTiles(int worker);
+    // Tiled step: only tiles changed by previous tick and their neighbours are computed
+    void tickTiles();
+
 public:
     // Default logic B3/S23
     Logic(Field* field);
@@ -89,11 +422,54 @@ public:
     // e.g. B123 => b = 123
     //      B45  => b = 45
     //      S140 => s = 140
-    // WARNING: 0 in B/S parameters must NOT be first digit
+    // WARNING: 0 in B/S parameters must NOT be first digit,
+    // use SetRule() for B0 rules
     // Multiple same digits are counted as one: 1223 = 123
     Logic(Field* field, int b, int s);
+    Logic(const Logic&) = delete;
+    Logic& operator=(const Logic&) = delete;
+    ~Logic();
     void SetField(Field* field);
     Field* GetField();
+    void SetEngine(TickEngine engine);
+    TickEngine GetEngine();
+    void SetKernel(KernelIsa isa);
+    KernelIsa GetKernel();
+    // Number of threads used by Tick(), every thread takes
+    // a horizontal band of rows. Result does not depend on it
+    void SetThreads(int threads);
+    int GetThreads();
+    void SetSchedule(TickSchedule schedule);
+    TickSchedule GetSchedule();
+    // Rule as digit masks: bit k is set if k neighbours give birth/survival
+    void SetRule(uint16_t b_mask, uint16_t s_mask);
+    uint16_t GetBMask();
+    uint16_t GetSMask();
+    // Tiles computed and skipped by the last Tick() with SCHEDULE_TILES
+    // Both are 0 after a tick with other schedule
+    long long GetTilesEvaluated();
+    long long GetTilesSkipped();
+    // 64-bit hash of cells of the field
+    // After tiled ticks only tiles changed by the tick are rehashed,
+    // otherwise the whole field is hashed again
+    uint64_t GetStateHash();
+    // Live cells of the field, kept up to date by Tick() after the first call
+    // Field changed outside of Tick() is counted once by the next call
+    uint64_t GetPopulation();
+    // Rows and columns of live cells of the field, false if there are none
+    bool GetBoundingBox(int* min_x, int* min_y, int* max_x, int* max_y);
+    // Counters and tick timers, off by default
+    // Counting births and deaths reads cells changed by every tick once more
+    void EnableStats(bool enable);
+    bool StatsEnabled();
+    // Counters since stats were enabled or reset
+    TickStats GetStats();
+    void ResetStats();
+    // Generation of the field, loaded from snapshot presets
+    uint64_t GetGeneration();
+    void SetGeneration(uint64_t generation);
+    // Double-buffered step: next generation is computed into back
+    // buffer and swapped with the field, pointer to the field stays valid
     void Tick();
     void DrawField();
     int GetFieldHeight();
@@ -105,19 +481,64 @@ public:
     void FillQueueWithCurrentState(std::queue<CellOp*>* ops_q);
 
     void PrintMessages();
+    // Load messages not printed yet, they are cleared
+    std::vector<std::string> TakeMessages();
 
     bool GetAt(int x, int y);
 };
 
+// Engine of offline mode
+// OFFLINE_FIELD    - Logic over DEFAULT_FIELD_SIZE torus
+// OFFLINE_HASHLIFE - HashLife over unbounded plane
+// OFFLINE_SPARSE   - SparseField over unbounded plane
+enum OfflineEngine
+{
+    OFFLINE_FIELD,
+    OFFLINE_HASHLIFE,
+    OFFLINE_SPARSE
+};
+
+// Pacing of interactive run
+#define DEFAULT_FPS 25
+#define DEFAULT_MAX_GPS 25
+// Terminal lines below the field kept for info and input boxes
+#define UI_RESERVED_LINES 10
+
 // Struct for ModeSelector class
 // Contains passed parameters from UserInterfaceWrap class
 typedef struct ModeContext_s
 {
-    Logic** logic;
-    PresetParser** prepar;
+    Logic** logic = nullptr;
+    PresetParser** prepar = nullptr;
     std::string inputFile;
     std::string outputFile;
-    int offline_ticks;
+    long long offline_ticks = 0;
+    int threads = 1;
+    OfflineEngine engine = OFFLINE_FIELD;
+    // If not negative, offline mode runs 2^step_pow2 ticks instead of offline_ticks
+    int step_pow2 = -1;
+    // Offline mode saves snapshot every checkpoint_every ticks, 0 - never
+    long long checkpoint_every = 0;
+    // Checkpoint of interrupted offline run to continue from, empty if none
+    std::string resumeFile;
+    // Offline field run skips whole periods once the field repeats itself
+    bool detect_cycles = true;
+    // Offline field run writes stats every metrics_every ticks, empty - never
+    std::string metricsFile;
+    long long metrics_every = 1000;
+    // Characters of interactive frames
+    GlyphMode glyphs = GLYPH_ASCII;
+    // Interactive frames redraw only changed characters
+    bool diff_frames = false;
+    // Interactive run: frames drawn per second, generations computed
+    // per second (0 - as fast as possible) and generations between drawn ones
+    int fps = DEFAULT_FPS;
+    int max_gps = DEFAULT_MAX_GPS;
+    int display_every = 1;
+    // Batch mode boards: directory or manifest of presets,
+    // random soups of seeds seed_first..seed_last if empty
+    std::string batchSource;
+    uint64_t seed_first = 0, seed_last = 0;
 } ModeContext;
 
 // Strategy abstract class for selecting different app mode
@@ -150,13 +571,156 @@ public:
     virtual void ConfigLogic(ModeContext context);
 };
 
+// Batch mode. Runs many boards on a thread pool and writes one results line per board
+// offline_ticks limits generations of every board, 0 - SOUP_GENERATIONS
+class BatchMode : public ModeSelector
+{
+public:
+    virtual void ConfigLogic(ModeContext context);
+};
+
+/// <summary>
+/// Writes dumps of field on its own I/O thread.
+/// Push() copies the field and returns, so the simulation
+/// pays for a copy instead of formatting and writing the file
+/// </summary>
+class DumpQueue
+{
+private:
+    typedef struct DumpJob_s
+    {
+        std::unique_ptr<Field> field;
+        uint64_t generation;
+        std::string file;
+    } DumpJob;
+
+    PresetParser* _prepar;
+    std::mutex _mutex;
+    std::condition_variable _cv, _idle_cv;
+    std::deque<DumpJob> _jobs;
+    bool _writing = false;
+    // Messages of finished dumps not taken yet
+    std::vector<std::string> _results;
+    bool _stop = false;
+    std::thread _thread;
+
+    void run();
+
+public:
+    // Files are written by prepar->Save()
+    DumpQueue(PresetParser* prepar);
+    DumpQueue(const DumpQueue&) = delete;
+    DumpQueue& operator=(const DumpQueue&) = delete;
+    // Writes queued dumps before returning
+    ~DumpQueue();
+
+    void Push(Field* field, uint64_t generation, const std::string& file);
+    // Returns when every pushed dump is written
+    void Wait();
+    // "Dump file created" or error message of every dump finished since the last call
+    std::vector<std::string> TakeResults();
+};
+
+// Cells of field shown in terminal: rows [x0, x1), columns [y0, y1)
+typedef struct ViewWindow_s
+{
+    int x0 = 0, x1 = 0, y0 = 0, y1 = 0;
+} ViewWindow;
+
+// Generation published by simulation thread of interactive run
+// Only cells of window are copied: field holds rows [x0, x1)
+// and whole words of columns from y0 rounded down to a multiple of 64
+typedef struct FrameSnapshot_s
+{
+    Field field;
+    ViewWindow window;
+    // Size of the whole field
+    int n = 0, m = 0;
+    long long generation = 0;
+} FrameSnapshot;
+
 class UserInterfaceWrap
 {
+private:
+    Logic* _logic;
+    PresetParser* _prepar;
+    bool _help = false;
+    bool _exit = false;
+    FrameRenderer _renderer;
+    int _fps = DEFAULT_FPS;
+    int _display_every = 1;
+    // Part of field drawn, lines and columns follow terminal size
+    Viewport _viewport;
+    // Generations passed from simulation thread to drawing thread
+    TripleBuffer<FrameSnapshot> _snapshots;
+    // Load and dump messages shown until the next command
+    std::vector<std::string> _messages;
+
+    // Commands of simulation thread, guarded by _control_mutex
+    // Paused run computes only _steps generations
+    std::mutex _control_mutex;
+    std::condition_variable _control_cv;
+    bool _running = false;
+    long long _steps = 0;
+    int _max_gps = DEFAULT_MAX_GPS;
+    bool _stop = false;
+    // Simulation thread works on logic outside of the lock
+    bool _ticking = false;
+    std::vector<std::string> _dump_requests;
+    // Window copied by publish(), set by drawing thread when viewport changes
+    ViewWindow _view_request;
+    bool _publish_request = false;
+    std::unique_ptr<DumpQueue> _dumps;
+
+    // Error indicator for commands
+    // 0 - no errors
+    // 1 - tick error
+    // 2 - dump error
+    // 3 - help error
+    // 4 - exit error
+    // 5 - pan error
+    // 6 - zoom error
+    // 7 - speed error
+    int _errNo = 0;
+    std::string _error_msg = std::string("");
+
+    // Set game mode using ModeSelector and loading file by name
+    // Logic and prepar pointers of context are set to this object's ones
+    void setMode(ModeSelector* mode, ModeContext context);
+    // Fits viewport to terminal, reserved lines are left below the field
+    // Returns cells of n x m field shown by it
+    ViewWindow fitViewport(int n, int m, int reserved);
+    // Draw map of snapshot, its window is the one of viewport
+    void drawField(FrameSnapshot& snapshot);
+    // Zoom showing the whole field in terminal
+    void fitView();
+    // Lines of info box
+    void drawInfo(std::vector<std::string>& lines);
+    // Lines of box with user input and help
+    void drawUserInput(std::vector<std::string>& lines, bool help = false);
+    // Field of the newest snapshot with status line, info and input boxes,
+    // pending is text typed after the prompt so far
+    // False if snapshot does not hold the window of viewport, the window
+    // is asked from simulation thread then and nothing is drawn
+    bool drawFrame(const std::string& pending);
+
+    // Body of simulation thread, runs until _stop is set
+    // Generations are computed while running or while steps remain,
+    // at most _max_gps per second, dumps are taken between generations
+    void simulate();
+    // Copies requested window of field into snapshot for drawing thread
+    void publish();
+    // Steps and dumps asked so far are done
+    bool stepsDone();
+    void parseUInput(std::string line);
+
 public:
-    UserInterfaceWrap(ModeSelector* mode, 
-                      std::string inputFile, 
-                      std::string outputFile = std::string(""), 
+    UserInterfaceWrap(ModeSelector* mode,
+                      std::string inputFile,
+                      std::string outputFile = std::string(""),
                       int offlineTicks = 0);
+    // Mode parameters are taken from context, its logic and prepar are ignored
+    UserInterfaceWrap(ModeSelector* mode, ModeContext context);
     void Start();
     void DrawAll();
 };
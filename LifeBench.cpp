@@ -0,0 +1,354 @@
+#include <benchmark/benchmark.h>
+#include <random>
+#include <thread>
+#include <fstream>
+#include <cstdio>
+#include "Life.h"
+#include "SoupSearch.h"
+
+// Fills field with random cells of given density
+static void randomFill(Field* field, double density, unsigned seed)
+{
+	std::mt19937 gen(seed);
+	std::bernoulli_distribution alive(density);
+	for (int i = 0; i < field->getN(); i++)
+		for (int j = 0; j < field->getM(); j++)
+			field->setAt(i, j, alive(gen));
+}
+
+// Single-threaded Tick of soup
+// Arguments: side of square board, percent of live cells
+static void BM_Tick(benchmark::State& state)
+{
+	int side = (int)state.range(0);
+	Field field(side, side);
+	randomFill(&field, state.range(1) / 100.0, 6);
+	Logic l(&field);
+	for (auto _ : state)
+		l.Tick();
+	state.counters["cells/s"] = benchmark::Counter(
+		(double)state.iterations() * side * side, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_Tick)
+	->ArgsProduct({ { 256, 1024, 4096 }, { 5, 35 } })
+	->ArgNames({ "side", "density%" })
+	->Unit(benchmark::kMicrosecond);
+
+// Tick of 4k x 4k soup with population and bounding box sampled every generation
+// Argument: TickSchedule
+static void BM_TickWithSummary(benchmark::State& state)
+{
+	Field field(4096, 4096);
+	randomFill(&field, 0.35, 11);
+	Logic l(&field);
+	l.SetSchedule((TickSchedule)state.range(0));
+	int min_x, min_y, max_x, max_y;
+	for (auto _ : state)
+	{
+		l.Tick();
+		benchmark::DoNotOptimize(l.GetPopulation());
+		benchmark::DoNotOptimize(l.GetBoundingBox(&min_x, &min_y, &max_x, &max_y));
+	}
+	state.counters["cells/s"] = benchmark::Counter(
+		(double)state.iterations() * field.getN() * field.getM(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_TickWithSummary)
+	->Arg(SCHEDULE_BANDS)
+	->Arg(SCHEDULE_TILES)
+	->Unit(benchmark::kMicrosecond);
+
+// Cell access through getAt/setAt over 1k x 1k board, row by row
+// Argument: 0 - getAt, 1 - setAt
+static void BM_FieldAccess(benchmark::State& state)
+{
+	Field field(1024, 1024);
+	randomFill(&field, 0.35, 7);
+	bool set = state.range(0) == 1;
+	for (auto _ : state)
+	{
+		int alive = 0;
+		for (int i = 0; i < field.getN(); i++)
+			for (int j = 0; j < field.getM(); j++)
+			{
+				if (set) field.setAt(i, j, (i ^ j) & 1);
+				else     alive += field.getAt(i, j);
+			}
+		benchmark::DoNotOptimize(alive);
+	}
+	state.counters["cells/s"] = benchmark::Counter(
+		(double)state.iterations() * field.getN() * field.getM(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_FieldAccess)
+	->Arg(0)
+	->Arg(1)
+	->Unit(benchmark::kMillisecond);
+
+// FillQueueWithCurrentState of 1k x 1k soup with ~130k live cells
+static void BM_FillQueue(benchmark::State& state)
+{
+	Field field(1024, 1024);
+	randomFill(&field, 0.125, 8);
+	Logic l(&field);
+	for (auto _ : state)
+	{
+		std::queue<CellOp*> q;
+		l.FillQueueWithCurrentState(&q);
+		for (; !q.empty(); q.pop())
+			delete q.front();
+	}
+	state.counters["cells/s"] = benchmark::Counter(
+		(double)state.iterations() * field.getN() * field.getM(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_FillQueue)
+	->Unit(benchmark::kMillisecond);
+
+// Scaling of multithreaded Tick on 16k x 16k soup
+// Argument: number of threads
+static void BM_TickThreads(benchmark::State& state)
+{
+	static Field* soup = nullptr;
+	if (soup == nullptr)
+	{
+		soup = new Field(16384, 16384);
+		randomFill(soup, 0.35, 1);
+	}
+	Field field(*soup);
+	Logic l(&field);
+	l.SetThreads((int)state.range(0));
+	for (auto _ : state)
+		l.Tick();
+	state.counters["cells/s"] = benchmark::Counter(
+		(double)state.iterations() * field.getN() * field.getM(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_TickThreads)
+	->RangeMultiplier(2)
+	->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+	->Unit(benchmark::kMillisecond)
+	->UseRealTime();
+
+// Mostly empty 16k x 16k board with activity in one corner
+// Argument: TickSchedule
+static void BM_TickSparseSchedule(benchmark::State& state)
+{
+	Field field(16384, 16384);
+	Field blob(512, 512);
+	randomFill(&blob, 0.35, 2);
+	for (int i = 0; i < blob.getN(); i++)
+		for (int j = 0; j < blob.getM(); j++)
+			field.setAt(i, j, blob.getAt(i, j));
+	Logic l(&field);
+	l.SetSchedule((TickSchedule)state.range(0));
+	l.SetThreads(std::max(1u, std::thread::hardware_concurrency()));
+	for (auto _ : state)
+		l.Tick();
+	state.counters["cells/s"] = benchmark::Counter(
+		(double)state.iterations() * field.getN() * field.getM(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_TickSparseSchedule)
+	->Arg(SCHEDULE_BANDS)
+	->Arg(SCHEDULE_TILES)
+	->Unit(benchmark::kMillisecond)
+	->UseRealTime();
+
+// Preset loading throughput, 4k x 4k soup listed as ~2M cell lines
+// Argument: 0 - Parse into CellOp queue, 1 - Load into field
+static void BM_LoadPreset(benchmark::State& state)
+{
+	static std::string path;
+	static size_t bytes = 0;
+	if (path.empty())
+	{
+		path = "life_bench_preset.lif";
+		Field soup(4096, 4096);
+		randomFill(&soup, 0.125, 3);
+		std::ofstream preset(path);
+		preset << "#Life 1.06\n#N Bench soup\n#R B3/S23\n";
+		for (int i = 0; i < soup.getN(); i++)
+			for (int j = 0; j < soup.getM(); j++)
+				if (soup.getAt(i, j)) preset << i << ' ' << j << '\n';
+		bytes = (size_t)preset.tellp();
+	}
+	Field field(4096, 4096);
+	PresetParser p(path);
+	for (auto _ : state)
+	{
+		if (state.range(0) == 0)
+		{
+			std::queue<CellOp*> q;
+			p.Parse(&q);
+			for (; !q.empty(); q.pop())
+				delete q.front();
+		}
+		else
+		{
+			field.Clear();
+			p.Load(&field);
+		}
+	}
+	state.SetBytesProcessed((int64_t)state.iterations() * bytes);
+}
+BENCHMARK(BM_LoadPreset)
+	->Arg(0)
+	->Arg(1)
+	->Unit(benchmark::kMillisecond);
+
+// Dump of 4k x 4k soup with ~2M live cells
+// Argument: 0 - through CellOp queue, 1 - straight from field
+static void BM_DumpField(benchmark::State& state)
+{
+	Field field(4096, 4096);
+	randomFill(&field, 0.125, 4);
+	Logic l(&field);
+	PresetParser p(std::string(""));
+	std::string path = "life_bench_dump.lif";
+	for (auto _ : state)
+	{
+		if (state.range(0) == 0)
+		{
+			std::queue<CellOp*> q;
+			l.FillQueueWithCurrentState(&q);
+			p.Dump(&q, path);
+		}
+		else
+			p.Dump(&field, path);
+	}
+	std::remove(path.c_str());
+}
+BENCHMARK(BM_DumpField)
+	->Arg(0)
+	->Arg(1)
+	->Unit(benchmark::kMillisecond);
+
+// Checkpoint of 32k x 32k board with 1k x 1k soup
+// Argument: 0 - save, 1 - load
+static void BM_Snapshot32k(benchmark::State& state)
+{
+	Field field(32768, 32768);
+	Field blob(1024, 1024);
+	randomFill(&blob, 0.35, 5);
+	for (int i = 0; i < blob.getN(); i++)
+		for (int j = 0; j < blob.getM(); j++)
+			field.setAt(16384 + i, 16384 + j, blob.getAt(i, j));
+	PresetParser saver(std::string(""));
+	std::string path = "life_bench_checkpoint.snap";
+	saver.SaveSnapshot(&field, path, 0);
+	PresetParser loader(path);
+	for (auto _ : state)
+	{
+		if (state.range(0) == 0)
+			saver.SaveSnapshot(&field, path, 0);
+		else
+			loader.LoadSnapshot(&field);
+	}
+	std::ifstream saved(path, std::ios::binary | std::ios::ate);
+	state.counters["file_bytes"] = (double)saved.tellg();
+	std::remove(path.c_str());
+}
+BENCHMARK(BM_Snapshot32k)
+	->Arg(0)
+	->Arg(1)
+	->Unit(benchmark::kMillisecond);
+
+// Frame of 200 x 300 soup built in memory, nothing is written
+// Argument: GlyphMode
+static void BM_RenderFrame(benchmark::State& state)
+{
+	Field field(200, 300);
+	randomFill(&field, 0.35, 12);
+	FrameRenderer renderer((GlyphMode)state.range(0));
+	for (auto _ : state)
+	{
+		renderer.Begin();
+		renderer.AddField(&field);
+		benchmark::DoNotOptimize(renderer.GetFrame().data());
+	}
+	state.counters["bytes/frame"] = (double)renderer.GetFrame().size();
+	state.counters["frames/s"] = benchmark::Counter((double)state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_RenderFrame)
+	->Arg(GLYPH_ASCII)
+	->Arg(GLYPH_HALF_BLOCK)
+	->Arg(GLYPH_BRAILLE)
+	->Unit(benchmark::kMicrosecond);
+
+// Frames of consecutive generations of a settled soup in diff mode,
+// bytes/frame is compared with full frames of BM_RenderFrame
+// Argument: GlyphMode
+static void BM_RenderDiffFrame(benchmark::State& state)
+{
+	Field field(200, 300);
+	randomFill(&field, 0.35, 12);
+	Logic logic(&field);
+	for (int i = 0; i < 200; i++)
+		logic.Tick();
+	FrameRenderer renderer((GlyphMode)state.range(0));
+	renderer.SetDiff(true);
+	renderer.Begin();
+	renderer.AddField(logic.GetField());
+	size_t bytes = 0;
+	for (auto _ : state)
+	{
+		state.PauseTiming();
+		logic.Tick();
+		state.ResumeTiming();
+		renderer.Begin();
+		renderer.AddField(logic.GetField());
+		bytes += renderer.GetFrame().size();
+	}
+	state.counters["bytes/frame"] = (double)bytes / state.iterations();
+	state.counters["frames/s"] = benchmark::Counter((double)state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_RenderDiffFrame)
+	->Arg(GLYPH_ASCII)
+	->Arg(GLYPH_HALF_BLOCK)
+	->Arg(GLYPH_BRAILLE)
+	->Unit(benchmark::kMicrosecond);
+
+// 16384 x 16384 soup seen through 50 x 200 characters of terminal
+// Argument: zoom, 1 draws cells of the corner, larger zoom draws density view
+static void BM_RenderViewport(benchmark::State& state)
+{
+	Field field(16384, 16384);
+	randomFill(&field, 0.35, 12);
+	FrameRenderer renderer;
+	Viewport viewport;
+	viewport.lines = 50;
+	viewport.columns = 200;
+	viewport.zoom = (int)state.range(0);
+	renderer.SetViewport(viewport);
+	for (auto _ : state)
+	{
+		renderer.Begin();
+		renderer.AddField(&field);
+		benchmark::DoNotOptimize(renderer.GetFrame().data());
+	}
+	state.counters["bytes/frame"] = (double)renderer.GetFrame().size();
+	state.counters["cells/s"] = benchmark::Counter(
+		(double)state.iterations() * std::min(16384, 50 * viewport.zoom) * std::min(16384, 200 * viewport.zoom),
+		benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_RenderViewport)
+	->Arg(1)
+	->Arg(8)
+	->Arg(82)
+	->Arg(328)
+	->Unit(benchmark::kMicrosecond);
+
+// Random 16 x 16 soups run to their cycle, 1000 generations at most
+// Argument: number of threads
+static void BM_SoupSearch(benchmark::State& state)
+{
+	SoupSearch search((int)state.range(0));
+	search.SetGenerations(1000);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(search.RunSeeds(1, 64));
+	state.counters["boards/s"] = benchmark::Counter(
+		(double)state.iterations() * 64, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SoupSearch)
+	->RangeMultiplier(2)
+	->Range(1, std::max(1u, std::thread::hardware_concurrency()))
+	->Unit(benchmark::kMillisecond)
+	->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -1,5 +1,12 @@
 #include <gtest/gtest.h>
 #include "Life.h"
+#include "Checkpoint.h"
+#include "CycleDetector.h"
+#include "SoupSearch.h"
+#include <random>
+#include <fstream>
+#include <sstream>
+#include <thread>
 
 Field* f = new Field(5,5);
 Field* f2 = new Field(5,7);
@@ -72,6 +79,36 @@ TEST(FieldClassTest, GetOutOfBoundsPositive) {
 	EXPECT_TRUE(f->getAt(5,5));
 }
 
+TEST(FieldClassTest, PackedWordBoundaries) {
+	Field wide(3, 130);
+	wide.setAt(1, 63, true);
+	wide.setAt(1, 64, true);
+	wide.setAt(1, 129, true);
+	EXPECT_TRUE(wide.getAt(1, 63));
+	EXPECT_TRUE(wide.getAt(1, 64));
+	EXPECT_TRUE(wide.getAt(1, -1));
+	EXPECT_FALSE(wide.getAt(1, 65));
+	EXPECT_FALSE(wide.getAt(0, 63));
+	EXPECT_EQ(3u, wide.getRowWords());
+	EXPECT_EQ(0u, wide.getRow(1)[2] & ~wide.getLastWordMask());
+}
+
+TEST(FieldClassTest, PackedRowsAligned) {
+	Field wide(4, 100);
+	EXPECT_EQ(0u, wide.getStride() % 8);
+	for (int i = 0; i < wide.getN(); i++)
+		EXPECT_EQ(0u, (uintptr_t)wide.getRow(i) % 64);
+}
+
+TEST(FieldClassTest, CopyIsDeep) {
+	Field a(5, 70);
+	a.setAt(2, 66, true);
+	Field b(a);
+	a.Clear();
+	EXPECT_TRUE(b.getAt(2, 66));
+	EXPECT_FALSE(a.getAt(2, 66));
+}
+
 TEST(LogicClass, TickB123456780_S123456780) {
 
 }
@@ -87,5 +124,1131 @@ std::cout << s << std::endl;
 	l.Tick();
 	l.Tick();
 	l.Tick();
-	EXPECT_TRUE(f4->getAt(2,2));
+	// Glider moved by (1,1) after 4 ticks
+	EXPECT_TRUE(f4->getAt(4,3));
+	EXPECT_TRUE(f4->getAt(5,4));
+	EXPECT_TRUE(f4->getAt(3,5));
+	EXPECT_TRUE(f4->getAt(4,5));
+	EXPECT_TRUE(f4->getAt(5,5));
+	EXPECT_FALSE(f4->getAt(3,2));
+}
+
+// Fills field with random cells of given density
+static void randomFill(Field* field, double density, unsigned seed)
+{
+	std::mt19937 gen(seed);
+	std::bernoulli_distribution alive(density);
+	for (int i = 0; i < field->getN(); i++)
+		for (int j = 0; j < field->getM(); j++)
+			field->setAt(i, j, alive(gen));
+}
+
+static bool sameField(Field* a, Field* b)
+{
+	for (int i = 0; i < a->getN(); i++)
+		for (int j = 0; j < a->getM(); j++)
+			if (a->getAt(i, j) != b->getAt(i, j)) return false;
+	return true;
+}
+
+TEST(LogicClass, SwarMatchesScalar) {
+	int sizes[][2] = { {1,1}, {1,5}, {2,2}, {3,64}, {7,63}, {9,65}, {16,130}, {30,60}, {33,200} };
+	int rules[][2] = { {3,23}, {36,23}, {1,1230}, {2,0}, {345678,12345678} };
+	unsigned seed = 1;
+	for (auto& size : sizes)
+	{
+		for (auto& rule : rules)
+		{
+			Field swar(size[0], size[1]);
+			randomFill(&swar, 0.35, seed++);
+			Field scalar(swar);
+			Logic ls(&swar, rule[0], rule[1]);
+			Logic lr(&scalar, rule[0], rule[1]);
+			lr.SetEngine(ENGINE_SCALAR);
+			for (int t = 0; t < 8; t++)
+			{
+				ls.Tick();
+				lr.Tick();
+				ASSERT_TRUE(sameField(&swar, &scalar))
+					<< size[0] << "x" << size[1] << " B" << rule[0] << "/S" << rule[1] << " tick " << t;
+			}
+		}
+	}
+}
+
+TEST(LogicClass, RuleWithBirthOnZero) {
+	std::string path = testing::TempDir() + "b0_rule.lif";
+	{
+		std::ofstream preset(path);
+		preset << "#Life 1.06\n#D B0 rule\n#R B0/S8\n1 1\n";
+	}
+	PresetParser p(path);
+	Field swar(9, 70);
+	Logic ls(&swar);
+	ls.LoadPreset(&p);
+	EXPECT_EQ(1, ls.GetBMask());
+	EXPECT_EQ(1 << 8, ls.GetSMask());
+
+	Field scalar(swar);
+	Logic lr(&scalar);
+	lr.SetRule(ls.GetBMask(), ls.GetSMask());
+	lr.SetEngine(ENGINE_SCALAR);
+	for (int t = 0; t < 4; t++)
+	{
+		ls.Tick();
+		lr.Tick();
+		ASSERT_TRUE(sameField(&swar, &scalar)) << "tick " << t;
+		// Empty cells far from the seed are born on the first tick
+		if (t == 0)
+		{
+			EXPECT_TRUE(swar.getAt(5, 40));
+		}
+	}
+}
+
+TEST(PresetParserClass, LoadMatchesParse) {
+	std::string path = testing::TempDir() + "load_preset.lif";
+	{
+		std::ofstream preset(path, std::ios::binary);
+		preset << "#Life 1.06\r\n#D Crlf and spaces\r\n#D Comment\r\n#R B36/S23\r\n";
+		preset << "1 2\r\n  3\t4\n-1 -2\n5 6 trailing\nbad line\n3 4\n7 8";
+	}
+	PresetParser parsed(path);
+	std::queue<CellOp*> q;
+	parsed.Parse(&q);
+	Field expected(10, 10);
+	for (; !q.empty(); q.pop())
+	{
+		expected.setAt(q.front()->x, q.front()->y, true);
+		delete q.front();
+	}
+
+	PresetParser loaded(path);
+	Field field(10, 10);
+	EXPECT_EQ(1, loaded.Load(&field));
+	EXPECT_TRUE(sameField(&expected, &field));
+	// Life 1.06 lists column first
+	EXPECT_TRUE(field.getAt(2, 1));
+	EXPECT_TRUE(field.getAt(8, 9));
+	EXPECT_TRUE(field.getAt(8, 7));
+	EXPECT_FALSE(field.getAt(7, 8));
+	EXPECT_EQ(FORMAT_LIFE106, loaded.GetFormat());
+	EXPECT_EQ("Crlf and spaces", loaded.GetName());
+	EXPECT_EQ("Comment", loaded.GetComment());
+	EXPECT_EQ(36, loaded.GetB());
+	EXPECT_EQ(23, loaded.GetS());
+}
+
+TEST(PresetParserClass, DumpFieldMatchesQueue) {
+	Field field(37, 150);
+	randomFill(&field, 0.3, 9);
+	Logic l(&field);
+	std::queue<CellOp*> q;
+	l.FillQueueWithCurrentState(&q);
+	PresetParser p(std::string(""));
+	std::string queue_path = testing::TempDir() + "dump_queue.lif";
+	std::string field_path = testing::TempDir() + "dump_field.lif";
+	p.Dump(&q, queue_path);
+	p.Dump(&field, field_path);
+
+	std::ifstream a(queue_path), b(field_path);
+	std::stringstream queue_dump, field_dump;
+	queue_dump << a.rdbuf();
+	field_dump << b.rdbuf();
+	EXPECT_EQ(queue_dump.str(), field_dump.str());
+
+	PresetParser loaded(field_path);
+	Field copy(37, 150);
+	loaded.Load(&copy);
+	EXPECT_TRUE(sameField(&field, &copy));
+}
+
+TEST(PresetParserClass, Life106ListsColumnFirst) {
+	Field field(5, 10);
+	field.setAt(1, 7, true);
+	PresetParser saver(std::string(""));
+	std::string life106_path = testing::TempDir() + "column_first.lif";
+	std::string native_path = testing::TempDir() + "column_first.txt";
+	saver.Save(&field, life106_path);
+	saver.Save(&field, native_path);
+
+	std::ifstream a(life106_path), b(native_path);
+	std::stringstream life106_dump, native_dump;
+	life106_dump << a.rdbuf();
+	native_dump << b.rdbuf();
+	EXPECT_EQ("#Life 1.06\n#D Default loaded preset\n#D ...\n#R B3/S23\n7 1\n", life106_dump.str());
+	EXPECT_EQ("Default loaded preset\n#N ...\n#R B3/S23\n1 7\n", native_dump.str());
+}
+
+TEST(LogicClass, KernelsMatchScalar) {
+	int sizes[][2] = { {3,64}, {5,129}, {6,320}, {7,575}, {9,640}, {8,1000}, {4,1089} };
+	int rules[][2] = { {3,23}, {36,23}, {1,1230} };
+	KernelIsa kernels[] = { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512 };
+	for (KernelIsa isa : kernels)
+	{
+		if (!kernelSupported(isa)) continue;
+		unsigned seed = 100;
+		for (auto& size : sizes)
+		{
+			for (auto& rule : rules)
+			{
+				Field packed(size[0], size[1]);
+				randomFill(&packed, 0.4, seed++);
+				Field scalar(packed);
+				Logic lp(&packed, rule[0], rule[1]);
+				Logic lr(&scalar, rule[0], rule[1]);
+				lp.SetKernel(isa);
+				lr.SetEngine(ENGINE_SCALAR);
+				for (int t = 0; t < 4; t++)
+				{
+					lp.Tick();
+					lr.Tick();
+					ASSERT_TRUE(sameField(&packed, &scalar))
+						<< kernelIsaName(isa) << " " << size[0] << "x" << size[1]
+						<< " B" << rule[0] << "/S" << rule[1] << " tick " << t;
+				}
+			}
+		}
+	}
+}
+
+TEST(LogicClass, DoubleBufferReusesStorage) {
+	Field field(8, 100);
+	field.DefaultPreset();
+	Logic l(&field);
+	uint64_t* front = field.getRow(0);
+	l.Tick();
+	uint64_t* back = field.getRow(0);
+	EXPECT_NE(front, back);
+	l.Tick();
+	EXPECT_EQ(front, field.getRow(0));
+	l.Tick();
+	EXPECT_EQ(back, field.getRow(0));
+}
+
+TEST(LogicClass, ThreadsMatchSingleThread) {
+	int sizes[][2] = { {1,70}, {3,64}, {17,130}, {64,700} };
+	int thread_counts[] = { 2, 3, 8 };
+	TickEngine engines[] = { ENGINE_SWAR, ENGINE_SCALAR };
+	for (auto& size : sizes)
+	{
+		for (int threads : thread_counts)
+		{
+			for (TickEngine engine : engines)
+			{
+				Field multi(size[0], size[1]);
+				randomFill(&multi, 0.3, threads * 31 + size[0]);
+				Field single(multi);
+				Logic lm(&multi);
+				Logic ls(&single);
+				lm.SetEngine(engine);
+				ls.SetEngine(engine);
+				lm.SetThreads(threads);
+				EXPECT_EQ(threads, lm.GetThreads());
+				for (int t = 0; t < 6; t++)
+				{
+					lm.Tick();
+					ls.Tick();
+					ASSERT_TRUE(sameField(&multi, &single))
+						<< threads << " threads " << size[0] << "x" << size[1] << " tick " << t;
+				}
+			}
+		}
+	}
+}
+
+TEST(LogicClass, TilesMatchBands) {
+	int sizes[][2] = { {10,10}, {64,512}, {130,1100}, {200,700} };
+	int rules[][2] = { {3,23}, {36,125}, {12,34} };
+	for (auto& size : sizes)
+	{
+		for (auto& rule : rules)
+		{
+			for (int threads = 1; threads <= 3; threads += 2)
+			{
+				// Sparse board: one random blob near the corner, activity crosses the torus border
+				Field tiled(size[0], size[1]);
+				for (int i = -6; i < 6; i++)
+					for (int j = -6; j < 6; j++)
+						tiled.setAt(i, j, (i * 7 + j * 13 + size[1]) % 3 == 0);
+				Field bands(tiled);
+				Logic lt(&tiled, rule[0], rule[1]);
+				Logic lb(&bands, rule[0], rule[1]);
+				lt.SetSchedule(SCHEDULE_TILES);
+				lt.SetThreads(threads);
+				for (int t = 0; t < 40; t++)
+				{
+					if (t == 20)
+					{
+						// Cells set outside of Tick must be noticed
+						tiled.setAt(size[0] / 2, size[1] / 2, true);
+						bands.setAt(size[0] / 2, size[1] / 2, true);
+					}
+					lt.Tick();
+					lb.Tick();
+					ASSERT_TRUE(sameField(&tiled, &bands))
+						<< size[0] << "x" << size[1] << " B" << rule[0] << "/S" << rule[1]
+						<< " threads " << threads << " tick " << t;
+				}
+			}
+		}
+	}
+}
+
+TEST(LogicClass, TilesWithBirthOnZero) {
+	Field tiled(70, 600);
+	randomFill(&tiled, 0.05, 7);
+	Field bands(tiled);
+	// B01/S0: 0 is not the first digit of 10
+	Logic lt(&tiled, 10, 0);
+	Logic lb(&bands, 10, 0);
+	lt.SetSchedule(SCHEDULE_TILES);
+	for (int t = 0; t < 5; t++)
+	{
+		lt.Tick();
+		lb.Tick();
+		ASSERT_TRUE(sameField(&tiled, &bands)) << "tick " << t;
+	}
+}
+
+TEST(LogicClass, TilesSkipStableAreas) {
+	Field field(256, 2048);
+	// Block (still life) inside tile (1, 1)
+	field.setAt(100, 600, true);
+	field.setAt(100, 601, true);
+	field.setAt(101, 600, true);
+	field.setAt(101, 601, true);
+	Logic l(&field);
+	l.SetSchedule(SCHEDULE_TILES);
+	l.Tick();
+	EXPECT_EQ(9, l.GetTilesEvaluated());
+	EXPECT_EQ(7, l.GetTilesSkipped());
+	l.Tick();
+	EXPECT_EQ(0, l.GetTilesEvaluated());
+	EXPECT_EQ(16, l.GetTilesSkipped());
+
+	// Blinker (oscillator) inside tile (3, 3) keeps its tile changing
+	field.setAt(200, 1800, true);
+	field.setAt(200, 1801, true);
+	field.setAt(200, 1802, true);
+	// Cells set outside: tiles with live cells are rescanned once
+	l.Tick();
+	EXPECT_EQ(14, l.GetTilesEvaluated());
+	for (int t = 0; t < 4; t++)
+	{
+		l.Tick();
+		EXPECT_EQ(9, l.GetTilesEvaluated());
+		EXPECT_EQ(7, l.GetTilesSkipped());
+	}
+	EXPECT_TRUE(field.getAt(100, 600));
+	EXPECT_TRUE(field.getAt(200, 1801));
+	EXPECT_TRUE(field.getAt(199, 1801));
+}
+
+TEST(HashLifeClass, MatchesLogicAwayFromEdges) {
+	int rules[][2] = { {3, 23}, {36, 23}, {3, 12345} };
+	for (auto& rule : rules)
+	{
+		// Soup in the center stays away from torus edges for 64 ticks
+		Field field(256, 256);
+		Field soup(32, 32);
+		randomFill(&soup, 0.4, 11);
+		HashLife universe(digitMask(rule[0]), digitMask(rule[1]));
+		for (int x = 0; x < 32; x++)
+			for (int y = 0; y < 32; y++)
+				if (soup.getAt(x, y))
+				{
+					field.setAt(112 + x, 112 + y, true);
+					universe.SetCell(x - 16, y - 16, true);
+				}
+		Logic l(&field, rule[0], rule[1]);
+		for (int t = 0; t < 64; t++) l.Tick();
+		universe.Step(64);
+		EXPECT_EQ(64u, universe.GetGeneration());
+
+		uint64_t population = 0;
+		for (int x = 0; x < 256; x++)
+			for (int y = 0; y < 256; y++)
+			{
+				if (field.getAt(x, y)) population++;
+				ASSERT_EQ(field.getAt(x, y), universe.GetCell(x - 128, y - 128))
+					<< "B" << rule[0] << "/S" << rule[1] << " at " << x << "," << y;
+			}
+		EXPECT_EQ(population, universe.GetPopulation());
+	}
+}
+
+TEST(HashLifeClass, MatchesSparseFieldTowardsRootEdge) {
+	// Gliders heading NW, NE, SW and SE, shifted so they start next to the root edge
+	int gliders[4][5][2] = {
+		{ {0,0}, {0,1}, {0,2}, {1,0}, {2,1} },
+		{ {0,0}, {0,1}, {0,2}, {1,2}, {2,1} },
+		{ {2,0}, {2,1}, {2,2}, {1,0}, {0,1} },
+		{ {2,0}, {2,1}, {2,2}, {1,2}, {0,1} } };
+	for (auto& glider : gliders)
+	{
+		for (int offset = -4; offset <= 4; offset++)
+		{
+			HashLife universe(digitMask(3), digitMask(23));
+			SparseField sparse(digitMask(3), digitMask(23));
+			for (auto& cell : glider)
+			{
+				universe.SetCell(cell[0] + offset, cell[1] + offset, true);
+				sparse.SetCell(cell[0] + offset, cell[1] + offset, true);
+			}
+			for (uint64_t steps : { 1, 1, 2, 5, 8, 100 })
+			{
+				universe.Step(steps);
+				sparse.Step(steps);
+				ASSERT_EQ(sparse.GetPopulation(), universe.GetPopulation())
+					<< "offset " << offset << " generation " << sparse.GetGeneration();
+				sparse.ForEachCell([&](int64_t x, int64_t y) {
+					ASSERT_TRUE(universe.GetCell(x, y)) << x << "," << y;
+				});
+			}
+		}
+	}
+}
+
+TEST(HashLifeClass, GliderFarFuture) {
+	HashLife universe(digitMask(3), digitMask(23));
+	universe.SetCell(0, 1, true);
+	universe.SetCell(1, 2, true);
+	universe.SetCell(2, 0, true);
+	universe.SetCell(2, 1, true);
+	universe.SetCell(2, 2, true);
+	universe.StepPow2(40);
+	EXPECT_EQ((uint64_t)1 << 40, universe.GetGeneration());
+	EXPECT_EQ(5u, universe.GetPopulation());
+	// Glider moves by (1, 1) every 4 generations
+	int64_t d = (int64_t)1 << 38;
+	EXPECT_TRUE(universe.GetCell(d + 0, d + 1));
+	EXPECT_TRUE(universe.GetCell(d + 1, d + 2));
+	EXPECT_TRUE(universe.GetCell(d + 2, d + 0));
+	EXPECT_TRUE(universe.GetCell(d + 2, d + 1));
+	EXPECT_TRUE(universe.GetCell(d + 2, d + 2));
+}
+
+TEST(HashLifeClass, BirthOnZeroThrows) {
+	EXPECT_THROW(HashLife(digitMask(10), digitMask(23)), std::invalid_argument);
+}
+
+TEST(HashLifeClass, SetRuleDropsResults) {
+	Field soup(60, 60);
+	randomFill(&soup, 0.35, 8);
+	SparseField sparse(digitMask(3), digitMask(23));
+	HashLife universe(digitMask(3), digitMask(23));
+	for (int x = 0; x < 60; x++)
+		for (int y = 0; y < 60; y++)
+			if (soup.getAt(x, y))
+			{
+				sparse.SetCell(x, y, true);
+				universe.SetCell(x, y, true);
+			}
+	sparse.Step(16);
+	universe.Step(16);
+	sparse.SetRule(digitMask(36), digitMask(23));
+	universe.SetRule(digitMask(36), digitMask(23));
+	sparse.Step(16);
+	universe.Step(16);
+	EXPECT_EQ(universe.GetPopulation(), sparse.GetPopulation());
+	sparse.ForEachCell([&](int64_t x, int64_t y) {
+		ASSERT_TRUE(universe.GetCell(x, y)) << x << "," << y;
+	});
+	EXPECT_THROW(sparse.SetRule(digitMask(10), digitMask(23)), std::invalid_argument);
+}
+
+TEST(SparseFieldClass, MatchesHashLife) {
+	int rules[][2] = { {3, 23}, {36, 23}, {1, 1} };
+	for (auto& rule : rules)
+	{
+		// Soup across chunk borders, including negative coordinates
+		Field soup(100, 100);
+		randomFill(&soup, 0.35, 5);
+		SparseField sparse(digitMask(rule[0]), digitMask(rule[1]));
+		HashLife universe(digitMask(rule[0]), digitMask(rule[1]));
+		for (int x = 0; x < 100; x++)
+			for (int y = 0; y < 100; y++)
+				if (soup.getAt(x, y))
+				{
+					sparse.SetCell(x - 70, y - 30, true);
+					universe.SetCell(x - 70, y - 30, true);
+				}
+		for (int t = 0; t < 40; t++)
+		{
+			sparse.Step(1);
+			universe.Step(1);
+			ASSERT_EQ(universe.GetPopulation(), sparse.GetPopulation())
+				<< "B" << rule[0] << "/S" << rule[1] << " tick " << t;
+		}
+		uint64_t cells = 0;
+		sparse.ForEachCell([&](int64_t x, int64_t y) {
+			cells++;
+			ASSERT_TRUE(universe.GetCell(x, y)) << x << "," << y;
+		});
+		EXPECT_EQ(universe.GetPopulation(), cells);
+	}
+}
+
+TEST(SparseFieldClass, GliderDropsChunks) {
+	SparseField sparse(digitMask(3), digitMask(23));
+	sparse.SetCell(0, 1, true);
+	sparse.SetCell(1, 2, true);
+	sparse.SetCell(2, 0, true);
+	sparse.SetCell(2, 1, true);
+	sparse.SetCell(2, 2, true);
+	// Glider moves by (1, 1) every 4 generations, far out of its first chunk
+	sparse.Step(4000);
+	EXPECT_EQ(5u, sparse.GetPopulation());
+	EXPECT_TRUE(sparse.GetCell(1002, 1000));
+	EXPECT_FALSE(sparse.GetCell(2, 0));
+	EXPECT_LE(sparse.GetChunkCount(), 4u);
+	EXPECT_THROW(SparseField(digitMask(10), digitMask(23)), std::invalid_argument);
+}
+
+TEST(SnapshotFormat, LzRoundTrip) {
+	std::mt19937 gen(5);
+	std::vector<uint8_t> data(300000);
+	for (size_t i = 0; i < data.size(); i++)
+	{
+		// Random bytes, zero runs and repeated pattern
+		if (i < 100000)      data[i] = (uint8_t)gen();
+		else if (i < 200000) data[i] = 0;
+		else                 data[i] = (uint8_t)("glider"[i % 6]);
+	}
+	for (size_t size : { (size_t)0, (size_t)3, (size_t)13, data.size() })
+	{
+		std::vector<uint8_t> packed, restored(size);
+		lzCompress(data.data(), size, packed);
+		lzDecompress(packed.data(), packed.size(), restored.data(), size);
+		EXPECT_TRUE(std::equal(restored.begin(), restored.end(), data.begin())) << size;
+	}
+	std::vector<uint8_t> packed, restored(data.size());
+	lzCompress(data.data(), data.size(), packed);
+	EXPECT_LT(packed.size(), 110000u);
+	EXPECT_THROW(lzDecompress(packed.data(), packed.size() / 2, restored.data(), restored.size()),
+	             std::invalid_argument);
+}
+
+TEST(SnapshotFormat, SaveLoadRoundTrip) {
+	double densities[] = { 0.001, 0.4 };
+	for (double density : densities)
+	{
+		for (bool compress : { false, true })
+		{
+			Field field(70, 1000);
+			randomFill(&field, density, 3);
+			std::string path = testing::TempDir() + "round_trip.snap";
+			PresetParser saver(std::string(""));
+			saver.SaveSnapshot(&field, path, 123456789012345ULL, compress);
+
+			PresetParser loader(path);
+			ASSERT_TRUE(loader.IsSnapshot());
+			Field loaded(5, 5);
+			Logic l(&loaded);
+			l.LoadPreset(&loader);
+			EXPECT_EQ(70, loaded.getN());
+			EXPECT_EQ(1000, loaded.getM());
+			EXPECT_TRUE(sameField(&field, &loaded)) << density << " " << compress;
+			EXPECT_EQ(123456789012345ULL, l.GetGeneration());
+			EXPECT_EQ(1 << 3, l.GetBMask());
+			EXPECT_EQ(saver.GetName(), loader.GetName());
+		}
+	}
+}
+
+TEST(SnapshotFormat, RejectsCorruptedFile) {
+	Field field(64, 64);
+	randomFill(&field, 0.3, 8);
+	std::ostringstream out;
+	writeSnapshot(out, SnapshotHeader(), &field);
+	std::string data = out.str();
+	Field loaded;
+	EXPECT_NO_THROW(readSnapshot(data.data(), data.size(), &loaded));
+	EXPECT_THROW(readSnapshot(data.data(), data.size() - 20, &loaded), std::invalid_argument);
+	data[8] = 9;
+	EXPECT_THROW(readSnapshot(data.data(), data.size(), &loaded), std::invalid_argument);
+
+	// Header claiming 2^31 - 1 rows and columns, payload holds 64 rows
+	for (int flags = 0; flags < 2; flags++)
+	{
+		Field small(64, 64);
+		if (flags == 0) randomFill(&small, 0.5, 9);
+		std::ostringstream huge;
+		writeSnapshot(huge, SnapshotHeader(), &small);
+		std::string bad = huge.str();
+		for (int offset : { SNAPSHOT_MAGIC_SIZE + 8, SNAPSHOT_MAGIC_SIZE + 12 })
+		{
+			bad[offset] = bad[offset + 1] = bad[offset + 2] = (char)0xFF;
+			bad[offset + 3] = 0x7F;
+		}
+		EXPECT_THROW(readSnapshot(bad.data(), bad.size(), &loaded), std::invalid_argument) << "flags " << flags;
+	}
+}
+
+// Writes text into temporary file, returns its path
+static std::string writeTemp(std::string name, std::string text)
+{
+	std::string path = testing::TempDir() + name;
+	std::ofstream out(path, std::ios::binary);
+	out << text;
+	return path;
+}
+
+static void expectGlider(Field* field)
+{
+	EXPECT_TRUE(field->getAt(0, 1));
+	EXPECT_TRUE(field->getAt(1, 2));
+	EXPECT_TRUE(field->getAt(2, 0));
+	EXPECT_TRUE(field->getAt(2, 1));
+	EXPECT_TRUE(field->getAt(2, 2));
+	int alive = 0;
+	for (int i = 0; i < field->getN(); i++)
+		for (int j = 0; j < field->getM(); j++)
+			alive += field->getAt(i, j);
+	EXPECT_EQ(5, alive);
+}
+
+TEST(PresetParserClass, ReadsRleAndPlaintext) {
+	std::string rle = "#N Glider\n#C Moves diagonally\nx = 3, y = 3, rule = 23/36\nbo$2b\no$3o!\n";
+	std::string cells = "!Name: Glider\n!Moves diagonally\n.O\n..O\nOOO\n";
+	// By extension and by contents
+	std::string paths[] = {
+		writeTemp("glider.rle", rle), writeTemp("glider_rle.txt", rle),
+		writeTemp("glider.cells", cells), writeTemp("glider_cells.txt", cells)
+	};
+	PresetFormat formats[] = { FORMAT_RLE, FORMAT_RLE, FORMAT_PLAINTEXT, FORMAT_PLAINTEXT };
+	for (int i = 0; i < 4; i++)
+	{
+		PresetParser p(paths[i]);
+		EXPECT_EQ(formats[i], p.GetFormat()) << paths[i];
+		Field field(8, 8);
+		p.Load(&field);
+		expectGlider(&field);
+		EXPECT_EQ("Glider", p.GetName());
+		EXPECT_EQ("Moves diagonally", p.GetComment().substr(p.GetComment().size() - 16));
+	}
+	PresetParser r(paths[0]);
+	Field field(8, 8);
+	r.Load(&field);
+	EXPECT_EQ(36, r.GetB());
+	EXPECT_EQ(23, r.GetS());
+}
+
+TEST(PresetParserClass, RepeatedRuleDigits) {
+	std::string path = testing::TempDir() + "repeated_digits.lif";
+	{
+		std::ofstream preset(path);
+		preset << "#Life 1.06\n#R B333333333333/S2222222222223\n0 0\n";
+	}
+	PresetParser p(path);
+	Field field(4, 4);
+	p.Load(&field);
+	EXPECT_EQ(1 << 3, p.GetBMask());
+	EXPECT_EQ((1 << 2) | (1 << 3), p.GetSMask());
+	EXPECT_EQ(3, p.GetB());
+	EXPECT_EQ(23, p.GetS());
+}
+
+TEST(PresetParserClass, SaveRoundTripAllFormats) {
+	Field field(50, 200);
+	randomFill(&field, 0.2, 12);
+	for (int i = 0; i < 50; i++) field.setAt(20, i, true);
+	for (int i = 0; i < 200; i++) field.setAt(30, i, false);
+	PresetParser saver(std::string(""));
+	std::string names[] = { "round.txt", "round.lif", "round.rle", "round.cells", "round.snap" };
+	PresetFormat formats[] = { FORMAT_NATIVE, FORMAT_LIFE106, FORMAT_RLE, FORMAT_PLAINTEXT, FORMAT_SNAPSHOT };
+	for (int i = 0; i < 5; i++)
+	{
+		std::string path = testing::TempDir() + names[i];
+		saver.Save(&field, path);
+		PresetParser loader(path);
+		EXPECT_EQ(formats[i], loader.GetFormat());
+		Field loaded(50, 200);
+		loader.Load(&loaded);
+		EXPECT_TRUE(sameField(&field, &loaded)) << names[i];
+	}
+}
+
+TEST(DumpQueueClass, WritesCopyTakenAtPush) {
+	Field field(40, 130);
+	randomFill(&field, 0.3, 4);
+	Field pushed(field);
+	PresetParser saver(std::string(""));
+	std::string path = testing::TempDir() + "queued.snap";
+	{
+		DumpQueue dumps(&saver);
+		dumps.Push(&field, 7, path);
+		// Field may change right after Push
+		field.Clear();
+		dumps.Wait();
+		std::vector<std::string> results = dumps.TakeResults();
+		ASSERT_EQ(1u, results.size());
+		EXPECT_EQ("Dump file created: " + path, results[0]);
+		EXPECT_TRUE(dumps.TakeResults().empty());
+	}
+	PresetParser loader(path);
+	Field loaded(40, 130);
+	loader.Load(&loaded);
+	EXPECT_TRUE(sameField(&pushed, &loaded));
+}
+
+TEST(CheckpointWriterClass, ResumeMatchesUninterruptedRun) {
+	Field field(40, 130);
+	randomFill(&field, 0.3, 21);
+	Field direct(field);
+	Logic ld(&direct);
+	for (int t = 0; t < 30; t++) ld.Tick();
+
+	std::string path = testing::TempDir() + "run.checkpoint.snap";
+	PresetParser p(std::string(""));
+	{
+		Logic l(&field);
+		CheckpointWriter checkpoints(&p, path);
+		for (int t = 0; t < 17; t++)
+		{
+			l.Tick();
+			if (l.GetGeneration() % 4 == 0)
+				checkpoints.Submit(&field, l.GetGeneration());
+		}
+		checkpoints.Wait();
+		EXPECT_GE(checkpoints.GetWritten(), 1);
+		EXPECT_EQ("", checkpoints.GetError());
+	}
+
+	PresetParser resume(path);
+	Field resumed(5, 5);
+	Logic lr(&resumed);
+	lr.LoadPreset(&resume);
+	EXPECT_EQ(16u, lr.GetGeneration());
+	while (lr.GetGeneration() < 30) lr.Tick();
+	EXPECT_TRUE(sameField(&direct, &resumed));
+}
+
+TEST(LogicClass, StateHashFollowsTiledTicks) {
+	Field field(300, 700);
+	randomFill(&field, 0.1, 5);
+	Logic l(&field);
+	l.SetSchedule(SCHEDULE_TILES);
+	uint64_t first = l.GetStateHash();
+	for (int t = 0; t < 20; t++)
+	{
+		l.Tick();
+		uint64_t incremental = l.GetStateHash();
+		field.markModified();
+		EXPECT_EQ(l.GetStateHash(), incremental) << "tick " << t;
+		EXPECT_NE(first, incremental);
+	}
+}
+
+TEST(CycleDetectorClass, FindsPeriodAndStart) {
+	// Block from a three-cell corner at generation 1 and a blinker
+	Field field(30, 30);
+	field.setAt(3, 3, 1); field.setAt(3, 4, 1); field.setAt(4, 3, 1);
+	field.setAt(15, 14, 1); field.setAt(15, 15, 1); field.setAt(15, 16, 1);
+	Logic l(&field);
+	CycleDetector cycles;
+	cycles.Observe(&l);
+	while (l.GetGeneration() < 20)
+	{
+		l.Tick();
+		if (cycles.Observe(&l)) break;
+	}
+	ASSERT_TRUE(cycles.Found());
+	EXPECT_EQ(2u, cycles.GetPeriod());
+	EXPECT_EQ(1u, cycles.GetStart());
+}
+
+TEST(CycleDetectorClass, SkipMatchesFullRun) {
+	// Glider on 16x16 torus comes back every 64 generations
+	Field field(16, 16);
+	field.setAt(0, 1, 1); field.setAt(1, 2, 1);
+	field.setAt(2, 0, 1); field.setAt(2, 1, 1); field.setAt(2, 2, 1);
+	Field direct(field);
+	Logic ld(&direct);
+	for (int t = 0; t < 1000; t++) ld.Tick();
+
+	Logic l(&field);
+	CycleDetector cycles;
+	cycles.Observe(&l);
+	while (l.GetGeneration() < 1000)
+	{
+		l.Tick();
+		if (cycles.Observe(&l)) break;
+	}
+	ASSERT_TRUE(cycles.Found());
+	EXPECT_EQ(64u, cycles.GetPeriod());
+	EXPECT_EQ(0u, cycles.GetStart());
+	uint64_t rest = (1000 - l.GetGeneration()) % cycles.GetPeriod();
+	for (uint64_t i = 0; i < rest; i++) l.Tick();
+	EXPECT_TRUE(sameField(&direct, &field));
+}
+
+TEST(CycleDetectorClass, ShortHistoryIsReused) {
+	// Short history wraps its ring and rebuilds its index many times,
+	// one detector is reset between soups
+	CycleDetector full, short_history(100);
+	for (unsigned seed = 1; seed <= 6; seed++)
+	{
+		Field soup(40, 40);
+		randomFill(&soup, 0.4, seed);
+		Field copy(soup);
+		Logic a(&soup), b(&copy);
+		full.Reset();
+		short_history.Reset();
+		full.Observe(&a);
+		short_history.Observe(&b);
+		for (int t = 0; t < 3000 && !full.Found(); t++)
+		{
+			a.Tick();
+			b.Tick();
+			full.Observe(&a);
+			short_history.Observe(&b);
+		}
+		ASSERT_TRUE(full.Found()) << "seed " << seed;
+		if (full.GetPeriod() >= 50) continue;
+		EXPECT_TRUE(short_history.Found()) << "seed " << seed;
+		EXPECT_EQ(full.GetPeriod(), short_history.GetPeriod()) << "seed " << seed;
+		EXPECT_EQ(full.GetStart(), short_history.GetStart()) << "seed " << seed;
+	}
+}
+
+TEST(SoupSearchClass, ThreadsGiveSameResults) {
+	SoupSearch single(1), parallel(3);
+	single.SetGenerations(3000);
+	parallel.SetGenerations(3000);
+	std::vector<SoupResult> a = single.RunSeeds(1, 24);
+	std::vector<SoupResult> b = parallel.RunSeeds(1, 24);
+	ASSERT_EQ(24u, a.size());
+	std::ostringstream sa, sb;
+	SoupSearch::WriteSeedResults(sa, 1, a);
+	SoupSearch::WriteSeedResults(sb, 1, b);
+	EXPECT_EQ(sa.str(), sb.str());
+	// Second run reuses worker fields
+	std::ostringstream again;
+	SoupSearch::WriteSeedResults(again, 1, parallel.RunSeeds(1, 24));
+	EXPECT_EQ(sa.str(), again.str());
+	// Listed seed jobs give the same boards
+	std::vector<SoupJob> jobs(24);
+	for (size_t i = 0; i < jobs.size(); i++)
+		jobs[i].seed = 1 + i;
+	std::ostringstream listed;
+	SoupSearch::WriteResults(listed, jobs, parallel.Run(jobs));
+	EXPECT_EQ(sa.str(), listed.str());
+	EXPECT_TRUE(single.RunSeeds(5, 4).empty());
+}
+
+TEST(SoupSearchClass, ManifestOfPresets) {
+	std::string blinker = writeTemp("soup_blinker.lif", "#Life 1.06\n7 5\n8 5\n9 5\n");
+	std::string manifest = writeTemp("soups.txt", "# boards\n" + blinker + "\n" + blinker + ".missing\n");
+	std::vector<SoupJob> jobs = SoupSearch::JobsFromSource(manifest);
+	ASSERT_EQ(2u, jobs.size());
+	SoupSearch search(2);
+	std::vector<SoupResult> results = search.Run(jobs);
+	EXPECT_EQ("", results[0].error);
+	EXPECT_EQ(3u, results[0].population);
+	EXPECT_EQ(2u, results[0].period);
+	EXPECT_EQ(0u, results[0].start);
+	// Confirmed at generation 4, horizontal phase of the blinker
+	EXPECT_EQ(4u, results[0].generation);
+	EXPECT_EQ(5, results[0].min_x);
+	EXPECT_EQ(5, results[0].max_x);
+	EXPECT_EQ(7, results[0].min_y);
+	EXPECT_EQ(9, results[0].max_y);
+	EXPECT_NE("", results[1].error);
+}
+
+static uint64_t population(Field* field)
+{
+	uint64_t count = 0;
+	for (int i = 0; i < field->getN(); i++)
+		for (int j = 0; j < field->getM(); j++)
+			count += field->getAt(i, j);
+	return count;
+}
+
+TEST(LogicClass, StatsCountBirthsAndDeaths) {
+	TickSchedule schedules[] = { SCHEDULE_BANDS, SCHEDULE_TILES };
+	for (TickSchedule schedule : schedules)
+	{
+		Field field(200, 600);
+		randomFill(&field, 0.2, 9);
+		Logic l(&field);
+		l.SetSchedule(schedule);
+		l.EnableStats(true);
+		EXPECT_EQ(population(&field), l.GetStats().population);
+		uint64_t births = 0, deaths = 0;
+		for (int t = 0; t < 15; t++)
+		{
+			Field before(field);
+			l.Tick();
+			for (int i = 0; i < field.getN(); i++)
+				for (int j = 0; j < field.getM(); j++)
+				{
+					births += !before.getAt(i, j) && field.getAt(i, j);
+					deaths += before.getAt(i, j) && !field.getAt(i, j);
+				}
+			TickStats stats = l.GetStats();
+			EXPECT_EQ(births, stats.births) << "schedule " << schedule << " tick " << t;
+			EXPECT_EQ(deaths, stats.deaths);
+			EXPECT_EQ(population(&field), stats.population);
+		}
+		TickStats stats = l.GetStats();
+		EXPECT_EQ(15u, stats.ticks);
+		EXPECT_EQ(births + deaths, stats.cells_changed);
+		EXPECT_GT(stats.cells_evaluated, 0u);
+		EXPECT_LE(stats.p50_tick_ns, stats.p99_tick_ns);
+		EXPECT_LE(stats.p99_tick_ns, stats.max_tick_ns);
+		// Back buffer allocated by the first tick, copies made by the test are not counted
+		EXPECT_EQ(1u, stats.allocations);
+	}
+}
+
+TEST(MetricsClass, HistogramPercentiles) {
+	LatencyHistogram h;
+	EXPECT_EQ(0u, h.Percentile(0.5));
+	for (uint64_t v = 1; v <= 10000; v++)
+		h.Record(v * 100);
+	EXPECT_NEAR(500000.0, (double)h.Percentile(0.5), 500000.0 / 8);
+	EXPECT_NEAR(990000.0, (double)h.Percentile(0.99), 990000.0 / 8);
+	EXPECT_EQ(1000000u, h.Percentile(1.0));
+	EXPECT_EQ(10000u, h.GetCount());
+}
+
+TEST(MetricsClass, ExportFormats) {
+	TickStats stats;
+	stats.generation = 42;
+	stats.population = 7;
+	std::string json = testing::TempDir() + "metrics.jsonl";
+	std::string prom = testing::TempDir() + "metrics.prom";
+	{
+		MetricsExporter a(json), b(prom);
+		EXPECT_EQ(METRICS_JSON, a.GetFormat());
+		EXPECT_EQ(METRICS_PROMETHEUS, b.GetFormat());
+		a.Export(stats);
+		a.Export(stats);
+		b.Export(stats);
+		b.Export(stats);
+	}
+	std::ifstream in(json);
+	std::string line;
+	int lines = 0;
+	while (std::getline(in, line))
+	{
+		lines++;
+		EXPECT_NE(std::string::npos, line.find("\"generation\":42"));
+	}
+	EXPECT_EQ(2, lines);
+	std::ifstream p(prom);
+	std::stringstream text;
+	text << p.rdbuf();
+	EXPECT_NE(std::string::npos, text.str().find("life_population 7\n"));
+	// File is replaced, not appended
+	EXPECT_EQ(text.str().find("life_generation 42"), text.str().rfind("life_generation 42"));
+}
+
+TEST(LogicClass, PopulationAndBoundingBox) {
+	TickSchedule schedules[] = { SCHEDULE_BANDS, SCHEDULE_TILES };
+	TickEngine engines[] = { ENGINE_SCALAR, ENGINE_SWAR };
+	for (TickSchedule schedule : schedules)
+		for (TickEngine engine : engines)
+		{
+			Field field(300, 700);
+			Field blob(40, 90);
+			randomFill(&blob, 0.35, 10);
+			for (int i = 0; i < blob.getN(); i++)
+				for (int j = 0; j < blob.getM(); j++)
+					field.setAt(130 + i, 300 + j, blob.getAt(i, j));
+			Logic l(&field);
+			l.SetSchedule(schedule);
+			l.SetEngine(engine);
+			l.SetThreads(2);
+			for (int t = 0; t < 30; t++)
+			{
+				// Edit outside of Tick() is picked up too
+				if (t == 20) field.setAt(299, 5, true);
+				int min_x = INT_MAX, min_y = INT_MAX, max_x = -1, max_y = -1;
+				for (int i = 0; i < field.getN(); i++)
+					for (int j = 0; j < field.getM(); j++)
+						if (field.getAt(i, j))
+						{
+							min_x = std::min(min_x, i); max_x = std::max(max_x, i);
+							min_y = std::min(min_y, j); max_y = std::max(max_y, j);
+						}
+				EXPECT_EQ(population(&field), l.GetPopulation()) << "tick " << t;
+				int box[4];
+				ASSERT_TRUE(l.GetBoundingBox(&box[0], &box[1], &box[2], &box[3]));
+				EXPECT_EQ(min_x, box[0]);
+				EXPECT_EQ(min_y, box[1]);
+				EXPECT_EQ(max_x, box[2]);
+				EXPECT_EQ(max_y, box[3]);
+				l.Tick();
+			}
+			field.Clear();
+			int box[4];
+			EXPECT_FALSE(l.GetBoundingBox(&box[0], &box[1], &box[2], &box[3]));
+			EXPECT_EQ(0u, l.GetPopulation());
+		}
+}
+
+TEST(FrameRendererClass, AsciiFrame) {
+	Field field(2, 3);
+	field.setAt(0, 0, true);
+	field.setAt(1, 2, true);
+	FrameRenderer renderer;
+	renderer.Begin();
+	renderer.AddField(&field);
+	renderer.AddLine("status");
+	EXPECT_EQ("\x1b[2J\x1b[H#  |\x1b[K\n  #|\x1b[K\n===|\x1b[K\nstatus\x1b[K\n", renderer.GetFrame());
+	// Only the first frame clears the whole screen
+	renderer.Begin();
+	EXPECT_EQ("\x1b[H", renderer.GetFrame());
+	renderer.Invalidate();
+	renderer.Begin();
+	EXPECT_EQ("\x1b[2J\x1b[H", renderer.GetFrame());
+}
+
+TEST(FrameRendererClass, PackedGlyphs) {
+	Field field(5, 3);
+	field.setAt(0, 0, true);
+	field.setAt(1, 1, true);
+	field.setAt(1, 2, true);
+	field.setAt(4, 2, true);
+	FrameRenderer renderer(GLYPH_HALF_BLOCK);
+	renderer.Begin();
+	renderer.AddField(&field);
+	// Rows 0-1, 2-3, and 4 alone
+	EXPECT_EQ("\x1b[2J\x1b[H"
+	          "\xE2\x96\x80\xE2\x96\x84\xE2\x96\x84|\x1b[K\n"
+	          "   |\x1b[K\n"
+	          "  \xE2\x96\x80|\x1b[K\n"
+	          "===|\x1b[K\n", renderer.GetFrame());
+
+	renderer.SetGlyphs(GLYPH_BRAILLE);
+	renderer.Begin();
+	renderer.AddField(&field);
+	// Dots 1+5 = U+2811, dot 2 = U+2802; row 4 gives dot 1 = U+2801
+	EXPECT_EQ("\x1b[H"
+	          "\xE2\xA0\x91\xE2\xA0\x82|\x1b[K\n"
+	          " \xE2\xA0\x81|\x1b[K\n"
+	          "==|\x1b[K\n", renderer.GetFrame());
+	GlyphMode mode;
+	EXPECT_TRUE(glyphModeFromName("half", &mode));
+	EXPECT_EQ(GLYPH_HALF_BLOCK, mode);
+	EXPECT_FALSE(glyphModeFromName("blocks", &mode));
+}
+
+TEST(FrameRendererClass, DiffFrames) {
+	Field field(2, 70);
+	field.setAt(0, 0, true);
+	FrameRenderer renderer;
+	renderer.SetDiff(true);
+	renderer.Begin();
+	renderer.AddField(&field);
+	renderer.AddLine("status");
+	EXPECT_EQ(0u, renderer.GetFrame().find("\x1b[2J\x1b[H#"));
+
+	// Unchanged field only moves cursor below itself
+	renderer.Begin();
+	renderer.AddField(&field);
+	renderer.AddLine("status");
+	EXPECT_EQ("\x1b[H\x1b[4;1Hstatus\x1b[K\n", renderer.GetFrame());
+
+	// Close changes make one run, far ones another, also across words
+	field.setAt(0, 0, false);
+	field.setAt(0, 3, true);
+	field.setAt(1, 66, true);
+	renderer.Begin();
+	renderer.AddField(&field);
+	EXPECT_EQ("\x1b[H\x1b[1;1H   #\x1b[2;67H#\x1b[4;1H", renderer.GetFrame());
+
+	// Braille character holds cells of two columns
+	renderer.SetGlyphs(GLYPH_BRAILLE);
+	renderer.Begin();
+	renderer.AddField(&field);
+	field.setAt(1, 2, true);
+	renderer.Begin();
+	renderer.AddField(&field);
+	EXPECT_EQ("\x1b[H\x1b[1;2H\xE2\xA0\x8A\x1b[3;1H", renderer.GetFrame());
+}
+
+TEST(FrameRendererClass, ViewportAndDensity) {
+	Field field(4, 6);
+	field.setAt(0, 0, true);
+	field.setAt(0, 1, true);
+	field.setAt(1, 0, true);
+	field.setAt(1, 1, true);
+	field.setAt(1, 3, true);
+	field.setAt(2, 2, true);
+	FrameRenderer renderer;
+	Viewport viewport;
+	viewport.x = 1;
+	viewport.y = 2;
+	viewport.lines = 2;
+	viewport.columns = 3;
+	renderer.SetViewport(viewport);
+	renderer.Begin();
+	renderer.AddField(&field);
+	EXPECT_EQ("\x1b[2J\x1b[H # |\x1b[K\n#  |\x1b[K\n===|\x1b[K\n", renderer.GetFrame());
+
+	// 2 x 2 blocks: full, one of four, empty
+	viewport = Viewport();
+	viewport.zoom = 2;
+	renderer.SetViewport(viewport);
+	renderer.Begin();
+	renderer.AddField(&field);
+	EXPECT_EQ("\x1b[H@- |\x1b[K\n - |\x1b[K\n===|\x1b[K\n", renderer.GetFrame());
+
+	// Block counts of every kernel match cell by cell counts
+	std::mt19937_64 gen(5);
+	uint64_t row[4] = { gen(), gen(), gen(), gen() };
+	for (KernelIsa isa : { KERNEL_SCALAR, bestKernelIsa() })
+	{
+		for (int block : { 1, 3, 64, 100 })
+		{
+			std::vector<int> counts((245 + block - 1) / block, 0), expected(counts.size(), 0);
+			getPackedBlockCount(isa)(row, 5, 250, block, counts.data());
+			for (int y = 5; y < 250; y++)
+				expected[(y - 5) / block] += (int)((row[y >> 6] >> (y & 63)) & 1);
+			EXPECT_EQ(expected, counts);
+		}
+	}
+}
+
+TEST(TripleBufferClass, ReaderGetsNewestPublished) {
+	TripleBuffer<int> buffer;
+	EXPECT_FALSE(buffer.Update());
+	buffer.Back() = 1;
+	buffer.Publish();
+	buffer.Back() = 2;
+	buffer.Publish();
+	EXPECT_TRUE(buffer.Update());
+	EXPECT_EQ(2, buffer.Front());
+	EXPECT_FALSE(buffer.Update());
+	EXPECT_EQ(2, buffer.Front());
+
+	// Reader on another thread sees growing values and the last one
+	TripleBuffer<int> shared;
+	std::atomic<bool> done(false);
+	std::thread writer([&]() {
+		for (int i = 1; i <= 100000; i++)
+		{
+			shared.Back() = i;
+			shared.Publish();
+		}
+		done.store(true, std::memory_order_release);
+	});
+	int last = 0;
+	while (true)
+	{
+		bool finished = done.load(std::memory_order_acquire);
+		if (shared.Update())
+		{
+			EXPECT_GT(shared.Front(), last);
+			last = shared.Front();
+		}
+		if (finished) break;
+	}
+	writer.join();
+	EXPECT_EQ(100000, last);
 }
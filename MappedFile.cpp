@@ -0,0 +1,51 @@
+#include "MappedFile.h"
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::invalid_argument("Input file not found");
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void* data = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            // Parsers read the file once front to back
+            madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+            _data = (const char*)data;
+            _size = (size_t)st.st_size;
+            _mapped = true;
+        }
+    }
+    close(fd);
+    if (_mapped) return;
+#endif
+    // Empty files, pipes and systems without mmap
+    std::ifstream infile(path, std::ios::binary);
+    if (!infile) throw std::invalid_argument("Input file not found");
+    std::ostringstream contents;
+    contents << infile.rdbuf();
+    _buffer = contents.str();
+    _data = _buffer.data();
+    _size = _buffer.size();
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (_mapped) munmap((void*)_data, _size);
+#endif
+}
+
+const char* MappedFile::Data() { return _data; }
+size_t MappedFile::Size()      { return _size; }
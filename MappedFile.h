@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+/// <summary>
+/// Read-only view of whole file contents.
+/// File is memory-mapped where supported (POSIX), otherwise read into memory.
+/// Throws std::invalid_argument if file can't be opened
+/// </summary>
+class MappedFile
+{
+private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+    // True if _data is a mapping, false if it is owned by _buffer
+    bool _mapped = false;
+    std::string _buffer;
+
+public:
+    MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* Data();
+    size_t Size();
+};
@@ -0,0 +1,139 @@
+#include "Metrics.h"
+#include "PackedKernels.h"
+#include <ostream>
+#include <cstdio>
+#include <stdexcept>
+
+#pragma region LatencyHistogram
+
+int LatencyHistogram::bucketOf(uint64_t value)
+{
+    if (value < LATENCY_EXACT) return (int)value;
+    int exp = highestBit(value);
+    int sub = (int)(value >> (exp - 3)) & (LATENCY_SUB_BUCKETS - 1);
+    return LATENCY_EXACT + (exp - 4) * LATENCY_SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketStart(int bucket)
+{
+    if (bucket < LATENCY_EXACT) return (uint64_t)bucket;
+    int exp = (bucket - LATENCY_EXACT) / LATENCY_SUB_BUCKETS + 4;
+    uint64_t sub = (uint64_t)((bucket - LATENCY_EXACT) % LATENCY_SUB_BUCKETS);
+    return ((uint64_t)LATENCY_SUB_BUCKETS + sub) << (exp - 3);
+}
+
+void LatencyHistogram::Record(uint64_t value)
+{
+    _buckets[bucketOf(value)]++;
+    _count++;
+    if (value > _max) _max = value;
+}
+
+void LatencyHistogram::Reset()
+{
+    for (uint64_t& b : _buckets) b = 0;
+    _count = 0;
+    _max = 0;
+}
+
+uint64_t LatencyHistogram::GetCount() { return _count; }
+uint64_t LatencyHistogram::GetMax()   { return _max;   }
+
+uint64_t LatencyHistogram::Percentile(double q)
+{
+    if (_count == 0) return 0;
+    uint64_t rank = (uint64_t)(q * (double)(_count - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; b++)
+    {
+        seen += _buckets[b];
+        if (seen >= rank)
+            return b + 1 < LATENCY_BUCKETS && bucketStart(b + 1) - 1 < _max
+                 ? bucketStart(b + 1) - 1 : _max;
+    }
+    return _max;
+}
+
+#pragma endregion
+
+void writeStatsJson(std::ostream& out, const TickStats& s)
+{
+    out << "{\"generation\":" << s.generation
+        << ",\"ticks\":" << s.ticks
+        << ",\"tick_ns\":{\"last\":" << s.last_tick_ns
+        << ",\"total\":" << s.total_tick_ns
+        << ",\"p50\":" << s.p50_tick_ns
+        << ",\"p99\":" << s.p99_tick_ns
+        << ",\"max\":" << s.max_tick_ns << '}'
+        << ",\"cells_evaluated\":" << s.cells_evaluated
+        << ",\"cells_changed\":" << s.cells_changed
+        << ",\"births\":" << s.births
+        << ",\"deaths\":" << s.deaths
+        << ",\"population\":" << s.population
+        << ",\"allocations\":" << s.allocations << "}\n";
+}
+
+static void promMetric(std::ostream& out, const char* name, const char* type,
+                       const char* help, uint64_t value)
+{
+    out << "# HELP life_" << name << ' ' << help << '\n'
+        << "# TYPE life_" << name << ' ' << type << '\n'
+        << "life_" << name << ' ' << value << '\n';
+}
+
+void writeStatsPrometheus(std::ostream& out, const TickStats& s)
+{
+    promMetric(out, "generation", "gauge", "Current generation.", s.generation);
+    promMetric(out, "ticks_total", "counter", "Ticks computed.", s.ticks);
+    out << "# HELP life_tick_latency_ns Tick latency quantiles, nanoseconds.\n"
+        << "# TYPE life_tick_latency_ns summary\n"
+        << "life_tick_latency_ns{quantile=\"0.5\"} " << s.p50_tick_ns << '\n'
+        << "life_tick_latency_ns{quantile=\"0.99\"} " << s.p99_tick_ns << '\n'
+        << "life_tick_latency_ns_sum " << s.total_tick_ns << '\n'
+        << "life_tick_latency_ns_count " << s.ticks << '\n';
+    promMetric(out, "tick_latency_max_ns", "gauge", "Longest tick, nanoseconds.", s.max_tick_ns);
+    promMetric(out, "cells_evaluated_total", "counter", "Cells computed by the kernel.", s.cells_evaluated);
+    promMetric(out, "cells_changed_total", "counter", "Cells changed by ticks.", s.cells_changed);
+    promMetric(out, "births_total", "counter", "Cells born.", s.births);
+    promMetric(out, "deaths_total", "counter", "Cells died.", s.deaths);
+    promMetric(out, "population", "gauge", "Live cells.", s.population);
+    promMetric(out, "allocations_total", "counter", "Cell buffers allocated by logic.", s.allocations);
+}
+
+MetricsExporter::MetricsExporter(std::string path)
+    : _path(path)
+{
+    const char* ext = ".prom";
+    bool prom = path.size() >= 5 && path.compare(path.size() - 5, 5, ext) == 0;
+    _format = prom ? METRICS_PROMETHEUS : METRICS_JSON;
+    if (_format == METRICS_JSON)
+    {
+        _json.open(path, std::ios::binary | std::ios::trunc);
+        if (!_json.is_open())
+            throw std::invalid_argument("Can not create metrics file " + path);
+    }
+}
+
+MetricsFormat MetricsExporter::GetFormat() { return _format; }
+
+// Prometheus file is written aside and renamed, so scrapers never see half of it
+void MetricsExporter::Export(const TickStats& stats)
+{
+    if (_format == METRICS_JSON)
+    {
+        writeStatsJson(_json, stats);
+        _json.flush();
+        return;
+    }
+    std::string temp = _path + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            throw std::invalid_argument("Can not create metrics file " + temp);
+        writeStatsPrometheus(out, stats);
+    }
+    // rename() does not replace existing files on Windows
+    std::remove(_path.c_str());
+    if (std::rename(temp.c_str(), _path.c_str()) != 0)
+        throw std::invalid_argument("Can not replace metrics file " + _path);
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <fstream>
+#include <iosfwd>
+#include <cstdint>
+
+// Buckets of LatencyHistogram: exact values below 16,
+// then 8 buckets per power of two
+#define LATENCY_EXACT 16
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_BUCKETS (LATENCY_EXACT + 60 * LATENCY_SUB_BUCKETS)
+
+/// <summary>
+/// Histogram of durations in nanoseconds with fixed memory.
+/// Values are kept with relative error below 1/8,
+/// enough for p50/p99 of tick latency over any number of ticks
+/// </summary>
+class LatencyHistogram
+{
+private:
+    uint64_t _buckets[LATENCY_BUCKETS] = {};
+    uint64_t _count = 0;
+    uint64_t _max = 0;
+
+    static int bucketOf(uint64_t value);
+    // Smallest value of bucket
+    static uint64_t bucketStart(int bucket);
+
+public:
+    void Record(uint64_t value);
+    void Reset();
+    uint64_t GetCount();
+    uint64_t GetMax();
+    // Value below which q of recorded values lie, q in [0, 1]
+    // 0 if nothing was recorded
+    uint64_t Percentile(double q);
+};
+
+// Counters of Logic since stats were enabled or reset
+typedef struct TickStats_s
+{
+    uint64_t generation = 0;
+    uint64_t ticks = 0;
+    // Tick latency
+    uint64_t last_tick_ns = 0, total_tick_ns = 0;
+    uint64_t p50_tick_ns = 0, p99_tick_ns = 0, max_tick_ns = 0;
+    // Cells computed by the kernel, tiled ticks skip settled tiles
+    uint64_t last_cells_evaluated = 0, cells_evaluated = 0;
+    // Cells changed is births + deaths
+    uint64_t last_cells_changed = 0, cells_changed = 0;
+    uint64_t births = 0, deaths = 0;
+    uint64_t population = 0;
+    // Cell buffers allocated by this logic, fields of other code are not counted
+    uint64_t allocations = 0;
+} TickStats;
+
+// Format of MetricsExporter
+// METRICS_JSON       - one JSON object per line, appended on every export
+// METRICS_PROMETHEUS - Prometheus text exposition, file is replaced on every export
+enum MetricsFormat
+{
+    METRICS_JSON,
+    METRICS_PROMETHEUS
+};
+
+void writeStatsJson(std::ostream& out, const TickStats& stats);
+void writeStatsPrometheus(std::ostream& out, const TickStats& stats);
+
+// Writes stats to file, format is chosen by extension: .prom - Prometheus, otherwise JSON lines
+class MetricsExporter
+{
+private:
+    std::string _path;
+    MetricsFormat _format;
+    std::ofstream _json;
+
+public:
+    // Throws std::invalid_argument if file can not be created
+    MetricsExporter(std::string path);
+    MetricsFormat GetFormat();
+    void Export(const TickStats& stats);
+};
@@ -0,0 +1,489 @@
+#include "PackedKernels.h"
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PACKED_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_AVX512
+#define TARGET_POPCNT
+#else
+#define TARGET_AVX2   __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#define TARGET_POPCNT __attribute__((target("popcnt")))
+#endif
+#endif
+
+// B3/S23 masks, rule with hardwired kernel path
+#define CONWAY_B_MASK (1 << 3)
+#define CONWAY_S_MASK ((1 << 2) | (1 << 3))
+
+#pragma region Scalar
+
+// Word-parallel (SWAR) generation step over packed rows.
+// Every neighbour of a cell is moved onto the cell's bit position,
+// then 8 neighbour planes are summed with bit-sliced full adders,
+// giving 4 bit planes of neighbour count (1, 2, 4, 8).
+
+// Cell value at column y of packed row
+static inline uint64_t rowBit(const uint64_t* row, int y)
+{
+    return (row[y >> 6] >> (y & 63)) & 1;
+}
+
+// Neighbours to the west (column y - 1) moved to column y
+static inline uint64_t westOf(const uint64_t* row, size_t w, int m)
+{
+    uint64_t carry = (w > 0) ? row[w - 1] >> 63 : rowBit(row, m - 1);
+    return (row[w] << 1) | carry;
+}
+
+// Neighbours to the east (column y + 1) moved to column y
+static inline uint64_t eastOf(const uint64_t* row, size_t w, size_t words, int m)
+{
+    if (w + 1 < words)
+        return (row[w] >> 1) | (row[w + 1] << 63);
+    return (row[w] >> 1) | (rowBit(row, 0) << ((m - 1) & 63));
+}
+
+static inline void fullAdder(uint64_t a, uint64_t b, uint64_t c, uint64_t& sum, uint64_t& carry)
+{
+    uint64_t ab = a ^ b;
+    sum = ab ^ c;
+    carry = (a & b) | (ab & c);
+}
+
+// Bit planes of neighbour count for one word
+static inline void countNeighbours(uint64_t a, uint64_t b, uint64_t c, uint64_t d,
+                                   uint64_t e, uint64_t f, uint64_t g, uint64_t h,
+                                   uint64_t& ones, uint64_t& twos, uint64_t& fours, uint64_t& eights)
+{
+    uint64_t s_up, c_up, s_down, c_down;
+    fullAdder(a, b, c, s_up, c_up);
+    fullAdder(f, g, h, s_down, c_down);
+    uint64_t s_mid = d ^ e, c_mid = d & e;
+
+    uint64_t c_ones;
+    fullAdder(s_up, s_down, s_mid, ones, c_ones);
+
+    uint64_t t, c_t;
+    fullAdder(c_up, c_down, c_mid, t, c_t);
+    twos = t ^ c_ones;
+    uint64_t c_twos = t & c_ones;
+
+    fours = c_t ^ c_twos;
+    eights = c_t & c_twos;
+}
+
+// Cells whose neighbour count is one of the digits in mask
+static inline uint64_t countInMask(uint64_t ones, uint64_t twos, uint64_t fours, uint64_t eights, uint16_t mask)
+{
+    uint64_t res = 0;
+    for (int k = 0; k <= 8; k++)
+    {
+        if (!(mask & (1 << k))) continue;
+        res |= ((k & 1) ? ones   : ~ones)
+             & ((k & 2) ? twos   : ~twos)
+             & ((k & 4) ? fours  : ~fours)
+             & ((k & 8) ? eights : ~eights);
+    }
+    return res;
+}
+
+// Next state of words [from, to) of row mid
+// CONWAY selects hardwired B3/S23, otherwise b_mask/s_mask are used
+template <bool CONWAY>
+static void stepPackedWords(const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+                            uint64_t* out, size_t from, size_t to, size_t words, int m,
+                            uint16_t b_mask, uint16_t s_mask)
+{
+    for (size_t w = from; w < to; w++)
+    {
+        uint64_t ones, twos, fours, eights;
+        countNeighbours(westOf(up, w, m),   up[w],   eastOf(up, w, words, m),
+                        westOf(mid, w, m),           eastOf(mid, w, words, m),
+                        westOf(down, w, m), down[w], eastOf(down, w, words, m),
+                        ones, twos, fours, eights);
+
+        // Same as scalar rule: alive && survive || birth
+        uint64_t next;
+        if (CONWAY)
+            next = twos & ~fours & ~eights & (ones | mid[w]);
+        else
+            next = countInMask(ones, twos, fours, eights, b_mask)
+                 | (mid[w] & countInMask(ones, twos, fours, eights, s_mask));
+        out[w] = next;
+    }
+}
+
+static void stepWordsScalar(const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+                            uint64_t* out, size_t from, size_t to, size_t words, int m,
+                            uint16_t b_mask, uint16_t s_mask)
+{
+    if (b_mask == CONWAY_B_MASK && s_mask == CONWAY_S_MASK)
+        stepPackedWords<true>(up, mid, down, out, from, to, words, m, b_mask, s_mask);
+    else
+        stepPackedWords<false>(up, mid, down, out, from, to, words, m, b_mask, s_mask);
+}
+
+static void stepRowScalar(const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+                          uint64_t* out, size_t from, size_t to, size_t words, int m,
+                          uint64_t last_mask, uint16_t b_mask, uint16_t s_mask)
+{
+    stepWordsScalar(up, mid, down, out, from, to, words, m, b_mask, s_mask);
+    if (to == words) out[words - 1] &= last_mask;
+}
+
+#pragma endregion
+
+#ifdef PACKED_KERNELS_X86
+
+// Vector kernels process interior words only: word 0 and the last word
+// need torus wrap of columns and are left to scalar code.
+// Interior word w takes its shifted-in bits from words w - 1 and w + 1,
+// which are read with unaligned loads.
+
+#pragma region AVX2
+
+TARGET_AVX2 static inline void fullAdderAvx2(__m256i a, __m256i b, __m256i c, __m256i& sum, __m256i& carry)
+{
+    __m256i ab = _mm256_xor_si256(a, b);
+    sum = _mm256_xor_si256(ab, c);
+    carry = _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(ab, c));
+}
+
+// Words [w, w + 4) of row shifted to the west and to the east
+TARGET_AVX2 static inline void shiftedAvx2(const uint64_t* row, size_t w, __m256i& west, __m256i& centre, __m256i& east)
+{
+    centre = _mm256_loadu_si256((const __m256i*)(row + w));
+    __m256i prev = _mm256_loadu_si256((const __m256i*)(row + w - 1));
+    __m256i next = _mm256_loadu_si256((const __m256i*)(row + w + 1));
+    west = _mm256_or_si256(_mm256_slli_epi64(centre, 1), _mm256_srli_epi64(prev, 63));
+    east = _mm256_or_si256(_mm256_srli_epi64(centre, 1), _mm256_slli_epi64(next, 63));
+}
+
+TARGET_AVX2 static inline __m256i countInMaskAvx2(__m256i ones, __m256i twos, __m256i fours, __m256i eights, uint16_t mask)
+{
+    __m256i res = _mm256_setzero_si256();
+    __m256i all = _mm256_set1_epi64x(-1);
+    for (int k = 0; k <= 8; k++)
+    {
+        if (!(mask & (1 << k))) continue;
+        __m256i t = all;
+        t = (k & 1) ? _mm256_and_si256(t, ones)   : _mm256_andnot_si256(ones, t);
+        t = (k & 2) ? _mm256_and_si256(t, twos)   : _mm256_andnot_si256(twos, t);
+        t = (k & 4) ? _mm256_and_si256(t, fours)  : _mm256_andnot_si256(fours, t);
+        t = (k & 8) ? _mm256_and_si256(t, eights) : _mm256_andnot_si256(eights, t);
+        res = _mm256_or_si256(res, t);
+    }
+    return res;
+}
+
+TARGET_AVX2 static void stepRowAvx2(const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+                                    uint64_t* out, size_t from, size_t to, size_t words, int m,
+                                    uint64_t last_mask, uint16_t b_mask, uint16_t s_mask)
+{
+    bool conway = b_mask == CONWAY_B_MASK && s_mask == CONWAY_S_MASK;
+    // Interior words [lo, hi) are vectorized, word 0 and the last word are not
+    size_t lo = from > 1 ? from : 1;
+    size_t hi = to < words - 1 ? to : words - 1;
+    stepWordsScalar(up, mid, down, out, from, lo < to ? lo : to, words, m, b_mask, s_mask);
+    size_t w = lo;
+    for (; w + 4 <= hi; w += 4)
+    {
+        __m256i a, b, c, d, mw, e, f, g, h;
+        shiftedAvx2(up, w, a, b, c);
+        shiftedAvx2(mid, w, d, mw, e);
+        shiftedAvx2(down, w, f, g, h);
+
+        __m256i s_up, c_up, s_down, c_down;
+        fullAdderAvx2(a, b, c, s_up, c_up);
+        fullAdderAvx2(f, g, h, s_down, c_down);
+        __m256i s_mid = _mm256_xor_si256(d, e), c_mid = _mm256_and_si256(d, e);
+
+        __m256i ones, c_ones, t, c_t;
+        fullAdderAvx2(s_up, s_down, s_mid, ones, c_ones);
+        fullAdderAvx2(c_up, c_down, c_mid, t, c_t);
+        __m256i twos = _mm256_xor_si256(t, c_ones);
+        __m256i c_twos = _mm256_and_si256(t, c_ones);
+        __m256i fours = _mm256_xor_si256(c_t, c_twos);
+        __m256i eights = _mm256_and_si256(c_t, c_twos);
+
+        __m256i next;
+        if (conway)
+            next = _mm256_andnot_si256(_mm256_or_si256(fours, eights),
+                                       _mm256_and_si256(twos, _mm256_or_si256(ones, mw)));
+        else
+            next = _mm256_or_si256(countInMaskAvx2(ones, twos, fours, eights, b_mask),
+                                   _mm256_and_si256(mw, countInMaskAvx2(ones, twos, fours, eights, s_mask)));
+        _mm256_storeu_si256((__m256i*)(out + w), next);
+    }
+    // Dirty upper halves of vector registers slow down SSE code run after the kernel
+    _mm256_zeroupper();
+    stepWordsScalar(up, mid, down, out, w > from ? w : from, to, words, m, b_mask, s_mask);
+    if (to == words) out[words - 1] &= last_mask;
+}
+
+#pragma endregion
+
+#pragma region AVX512
+
+// Ternary logic immediates: a ^ b ^ c and majority(a, b, c)
+#define TERNARY_XOR3 0x96
+#define TERNARY_MAJ  0xE8
+
+TARGET_AVX512 static inline void fullAdderAvx512(__m512i a, __m512i b, __m512i c, __m512i& sum, __m512i& carry)
+{
+    sum = _mm512_ternarylogic_epi64(a, b, c, TERNARY_XOR3);
+    carry = _mm512_ternarylogic_epi64(a, b, c, TERNARY_MAJ);
+}
+
+// Words [w, w + 8) of row shifted to the west and to the east
+TARGET_AVX512 static inline void shiftedAvx512(const uint64_t* row, size_t w, __m512i& west, __m512i& centre, __m512i& east)
+{
+    centre = _mm512_loadu_si512((const void*)(row + w));
+    __m512i prev = _mm512_loadu_si512((const void*)(row + w - 1));
+    __m512i next = _mm512_loadu_si512((const void*)(row + w + 1));
+    west = _mm512_or_si512(_mm512_slli_epi64(centre, 1), _mm512_srli_epi64(prev, 63));
+    east = _mm512_or_si512(_mm512_srli_epi64(centre, 1), _mm512_slli_epi64(next, 63));
+}
+
+TARGET_AVX512 static inline __m512i countInMaskAvx512(__m512i ones, __m512i twos, __m512i fours, __m512i eights, uint16_t mask)
+{
+    __m512i res = _mm512_setzero_si512();
+    __m512i all = _mm512_set1_epi64(-1);
+    for (int k = 0; k <= 8; k++)
+    {
+        if (!(mask & (1 << k))) continue;
+        __m512i t = all;
+        t = (k & 1) ? _mm512_and_si512(t, ones)   : _mm512_andnot_si512(ones, t);
+        t = (k & 2) ? _mm512_and_si512(t, twos)   : _mm512_andnot_si512(twos, t);
+        t = (k & 4) ? _mm512_and_si512(t, fours)  : _mm512_andnot_si512(fours, t);
+        t = (k & 8) ? _mm512_and_si512(t, eights) : _mm512_andnot_si512(eights, t);
+        res = _mm512_or_si512(res, t);
+    }
+    return res;
+}
+
+TARGET_AVX512 static void stepRowAvx512(const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+                                        uint64_t* out, size_t from, size_t to, size_t words, int m,
+                                        uint64_t last_mask, uint16_t b_mask, uint16_t s_mask)
+{
+    bool conway = b_mask == CONWAY_B_MASK && s_mask == CONWAY_S_MASK;
+    // Interior words [lo, hi) are vectorized, word 0 and the last word are not
+    size_t lo = from > 1 ? from : 1;
+    size_t hi = to < words - 1 ? to : words - 1;
+    stepWordsScalar(up, mid, down, out, from, lo < to ? lo : to, words, m, b_mask, s_mask);
+    size_t w = lo;
+    for (; w + 8 <= hi; w += 8)
+    {
+        __m512i a, b, c, d, mw, e, f, g, h;
+        shiftedAvx512(up, w, a, b, c);
+        shiftedAvx512(mid, w, d, mw, e);
+        shiftedAvx512(down, w, f, g, h);
+
+        __m512i s_up, c_up, s_down, c_down;
+        fullAdderAvx512(a, b, c, s_up, c_up);
+        fullAdderAvx512(f, g, h, s_down, c_down);
+        __m512i s_mid = _mm512_xor_si512(d, e), c_mid = _mm512_and_si512(d, e);
+
+        __m512i ones, c_ones, t, c_t;
+        fullAdderAvx512(s_up, s_down, s_mid, ones, c_ones);
+        fullAdderAvx512(c_up, c_down, c_mid, t, c_t);
+        __m512i twos = _mm512_xor_si512(t, c_ones);
+        __m512i c_twos = _mm512_and_si512(t, c_ones);
+        __m512i fours = _mm512_xor_si512(c_t, c_twos);
+        __m512i eights = _mm512_and_si512(c_t, c_twos);
+
+        __m512i next;
+        if (conway)
+            next = _mm512_andnot_si512(_mm512_or_si512(fours, eights),
+                                       _mm512_and_si512(twos, _mm512_or_si512(ones, mw)));
+        else
+            next = _mm512_or_si512(countInMaskAvx512(ones, twos, fours, eights, b_mask),
+                                   _mm512_and_si512(mw, countInMaskAvx512(ones, twos, fours, eights, s_mask)));
+        _mm512_storeu_si512((void*)(out + w), next);
+    }
+    _mm256_zeroupper();
+    stepWordsScalar(up, mid, down, out, w > from ? w : from, to, words, m, b_mask, s_mask);
+    if (to == words) out[words - 1] &= last_mask;
+}
+
+#pragma endregion
+
+#endif
+
+#pragma region Dispatch
+
+// True if kernel can run on this CPU
+bool kernelSupported(KernelIsa isa)
+{
+    switch (isa)
+    {
+    case KERNEL_SCALAR:
+        return true;
+#ifdef PACKED_KERNELS_X86
+#ifdef _MSC_VER
+    case KERNEL_AVX2:
+    case KERNEL_AVX512:
+    {
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave) return false;
+        unsigned long long xcr0 = _xgetbv(0);
+        __cpuidex(info, 7, 0);
+        if (isa == KERNEL_AVX2)
+            return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+        return (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0;
+    }
+#else
+    case KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case KERNEL_AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+#endif
+    default:
+        return false;
+    }
+}
+
+// Widest supported kernel, detected once by CPUID
+KernelIsa bestKernelIsa()
+{
+    static const KernelIsa best = kernelSupported(KERNEL_AVX512) ? KERNEL_AVX512
+                                : kernelSupported(KERNEL_AVX2)   ? KERNEL_AVX2
+                                                                 : KERNEL_SCALAR;
+    return best;
+}
+
+PackedRowKernel getPackedRowKernel(KernelIsa isa)
+{
+    if (!kernelSupported(isa))
+        throw std::invalid_argument(std::string("Kernel is not supported by CPU: ") + kernelIsaName(isa));
+
+    switch (isa)
+    {
+#ifdef PACKED_KERNELS_X86
+    case KERNEL_AVX2:   return stepRowAvx2;
+    case KERNEL_AVX512: return stepRowAvx512;
+#endif
+    default:            return stepRowScalar;
+    }
+}
+
+static uint64_t countRowScalar(const uint64_t* row, size_t from, size_t to)
+{
+    uint64_t count = 0;
+    for (size_t w = from; w < to; w++)
+        count += bitCount(row[w]);
+    return count;
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+// Every CPU with AVX2 has POPCNT, portable bitCount is a library call without it
+TARGET_POPCNT static uint64_t countRowPopcnt(const uint64_t* row, size_t from, size_t to)
+{
+    uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    size_t w = from;
+    for (; w + 4 <= to; w += 4)
+    {
+        c0 += (uint64_t)_mm_popcnt_u64(row[w]);
+        c1 += (uint64_t)_mm_popcnt_u64(row[w + 1]);
+        c2 += (uint64_t)_mm_popcnt_u64(row[w + 2]);
+        c3 += (uint64_t)_mm_popcnt_u64(row[w + 3]);
+    }
+    for (; w < to; w++)
+        c0 += (uint64_t)_mm_popcnt_u64(row[w]);
+    return c0 + c1 + c2 + c3;
+}
+#endif
+
+PackedRowCount getPackedRowCount(KernelIsa isa)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    if (isa != KERNEL_SCALAR && kernelSupported(isa))
+        return countRowPopcnt;
+#endif
+    return countRowScalar;
+}
+
+// Words are split at block ends falling inside them,
+// block ends past to are never reached, so counts beyond the last block stay untouched
+static void countBlocksScalar(const uint64_t* row, int from, int to, int block, int* counts)
+{
+    int c = 0, block_end = from + block;
+    for (int w = from >> 6; w <= (to - 1) >> 6; w++)
+    {
+        int base = w * 64;
+        uint64_t word = row[w];
+        if (base < from) word &= ~(uint64_t)0 << (from - base);
+        if (to - base < 64) word &= ((uint64_t)1 << (to - base)) - 1;
+        while (block_end < base + 64 && block_end < to)
+        {
+            uint64_t low = ((uint64_t)1 << (block_end - base)) - 1;
+            counts[c++] += bitCount(word & low);
+            word &= ~low;
+            block_end += block;
+        }
+        counts[c] += bitCount(word);
+        if (block_end == base + 64)
+        {
+            c++;
+            block_end += block;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+TARGET_POPCNT static void countBlocksPopcnt(const uint64_t* row, int from, int to, int block, int* counts)
+{
+    int c = 0, block_end = from + block;
+    for (int w = from >> 6; w <= (to - 1) >> 6; w++)
+    {
+        int base = w * 64;
+        uint64_t word = row[w];
+        if (base < from) word &= ~(uint64_t)0 << (from - base);
+        if (to - base < 64) word &= ((uint64_t)1 << (to - base)) - 1;
+        while (block_end < base + 64 && block_end < to)
+        {
+            uint64_t low = ((uint64_t)1 << (block_end - base)) - 1;
+            counts[c++] += (int)_mm_popcnt_u64(word & low);
+            word &= ~low;
+            block_end += block;
+        }
+        counts[c] += (int)_mm_popcnt_u64(word);
+        if (block_end == base + 64)
+        {
+            c++;
+            block_end += block;
+        }
+    }
+}
+#endif
+
+PackedBlockCount getPackedBlockCount(KernelIsa isa)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+    if (isa != KERNEL_SCALAR && kernelSupported(isa))
+        return countBlocksPopcnt;
+#endif
+    return countBlocksScalar;
+}
+
+const char* kernelIsaName(KernelIsa isa)
+{
+    switch (isa)
+    {
+    case KERNEL_SCALAR: return "scalar";
+    case KERNEL_AVX2:   return "avx2";
+    case KERNEL_AVX512: return "avx512";
+    }
+    return "unknown";
+}
+
+#pragma endregion
@@ -0,0 +1,75 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+// Number of set bits in packed word
+static inline int bitCount(uint64_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(w);
+#else
+    int count = 0;
+    for (; w; w &= w - 1) count++;
+    return count;
+#endif
+}
+
+// Index of the lowest set bit, w must not be 0
+static inline int lowestBit(uint64_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(w);
+#else
+    int bit = 0;
+    while (!((w >> bit) & 1)) bit++;
+    return bit;
+#endif
+}
+
+// Index of the highest set bit, w must not be 0
+static inline int highestBit(uint64_t w)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return 63 - __builtin_clzll(w);
+#else
+    int bit = 63;
+    while (!((w >> bit) & 1)) bit--;
+    return bit;
+#endif
+}
+
+// Instruction set used by packed row kernel
+// KERNEL_SCALAR - portable 64-bit SWAR code
+// KERNEL_AVX2   - 256 cells per instruction
+// KERNEL_AVX512 - 512 cells per instruction
+enum KernelIsa
+{
+    KERNEL_SCALAR,
+    KERNEL_AVX2,
+    KERNEL_AVX512
+};
+
+// Computes next state of words [from, to) of packed row mid into out
+// up and down are rows above and below mid, all rows hold
+// words words and m cells, last_mask clears padding of the last word.
+// b_mask/s_mask: bit k is set if k neighbours give birth/survival
+// out must not alias up, mid or down
+typedef void (*PackedRowKernel)(const uint64_t* up, const uint64_t* mid, const uint64_t* down,
+                                uint64_t* out, size_t from, size_t to, size_t words, int m,
+                                uint64_t last_mask, uint16_t b_mask, uint16_t s_mask);
+
+// True if kernel can run on this CPU
+bool kernelSupported(KernelIsa isa);
+// Widest supported kernel, detected once by CPUID
+KernelIsa bestKernelIsa();
+PackedRowKernel getPackedRowKernel(KernelIsa isa);
+
+// Number of live cells in words [from, to) of packed row
+typedef uint64_t (*PackedRowCount)(const uint64_t* row, size_t from, size_t to);
+// Row count for CPU of kernel, vector kernels count with POPCNT
+PackedRowCount getPackedRowCount(KernelIsa isa);
+// Adds live cells of columns [from, to) of packed row to counts,
+// counts[c] gets columns [from + c * block, from + (c + 1) * block)
+typedef void (*PackedBlockCount)(const uint64_t* row, int from, int to, int block, int* counts);
+PackedBlockCount getPackedBlockCount(KernelIsa isa);
+const char* kernelIsaName(KernelIsa isa);
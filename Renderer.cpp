@@ -0,0 +1,453 @@
+#include "Renderer.h"
+#include "Life.h"
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+
+#define ESC_HOME         "\x1b[H"
+#define ESC_CLEAR_SCREEN "\x1b[2J"
+#define ESC_CLEAR_LINE   "\x1b[K"
+#define ESC_CLEAR_BELOW  "\x1b[J"
+// Longest "\x1b[<line>;<column>H"
+#define ESC_MOVE_SIZE    26
+
+#define ACTIVE_CELL_CHAR '#'
+#define DEAD_CELL_CHAR ' '
+#define END_OF_FIELD_CHAR '|'
+#define BOTTOM_LINE_CHAR '='
+
+// Changed characters closer than this are written in one run,
+// rewriting a few unchanged characters is shorter than another cursor move
+#define DIFF_RUN_GAP 4
+
+// Characters of density view from empty to full block
+#define DENSITY_RAMP " .:-=+*#%@"
+#define DENSITY_LEVELS 10
+
+// UTF-8 of U+2580 upper half, U+2584 lower half and U+2588 full block
+static const char* const HALF_BLOCKS[4] = { "", "\xE2\x96\x80", "\xE2\x96\x84", "\xE2\x96\x88" };
+// Braille dot bit of (row, column) inside 4 x 2 character cell
+static const uint8_t BRAILLE_DOTS[4][2] = { { 0x01, 0x08 }, { 0x02, 0x10 }, { 0x04, 0x20 }, { 0x40, 0x80 } };
+
+bool glyphModeFromName(const std::string& name, GlyphMode* mode)
+{
+    if (name == "ascii")        *mode = GLYPH_ASCII;
+    else if (name == "half")    *mode = GLYPH_HALF_BLOCK;
+    else if (name == "braille") *mode = GLYPH_BRAILLE;
+    else return false;
+    return true;
+}
+
+bool terminalSize(int* lines, int* columns)
+{
+#ifdef _WIN32
+    CONSOLE_SCREEN_BUFFER_INFO info;
+    if (!GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info))
+        return false;
+    *lines = info.srWindow.Bottom - info.srWindow.Top + 1;
+    *columns = info.srWindow.Right - info.srWindow.Left + 1;
+#else
+    struct winsize size;
+    if (ioctl(1, TIOCGWINSZ, &size) != 0 || size.ws_row == 0)
+        return false;
+    *lines = size.ws_row;
+    *columns = size.ws_col;
+#endif
+    return true;
+}
+
+// Cell of packed row, y < m
+static inline int cellOf(const uint64_t* row, int y)
+{
+    return (int)((row[y >> 6] >> (y & 63)) & 1);
+}
+
+// Half block index of column y for upper row and lower row, lower may be nullptr
+static inline int halfBlockOf(const uint64_t* upper, const uint64_t* lower, int y)
+{
+    return cellOf(upper, y) | (lower != nullptr ? cellOf(lower, y) << 1 : 0);
+}
+
+// Braille dots of columns y, y + 1 of rows, rows after a nullptr are outside of field
+static inline int brailleDotsOf(const uint64_t* const* rows, int y, int m)
+{
+    int dots = 0;
+    for (int r = 0; r < 4; r++)
+    {
+        if (rows[r] == nullptr) break;
+        if (cellOf(rows[r], y)) dots |= BRAILLE_DOTS[r][0];
+        if (y + 1 < m && cellOf(rows[r], y + 1)) dots |= BRAILLE_DOTS[r][1];
+    }
+    return dots;
+}
+
+// Braille character U+2800 + dots is 3 bytes of UTF-8, empty cell is a space
+static inline char* putBraille(int dots, char* p)
+{
+    if (dots == 0)
+    {
+        *p++ = DEAD_CELL_CHAR;
+        return p;
+    }
+    int code = 0x2800 + dots;
+    *p++ = (char)(0xE0 | (code >> 12));
+    *p++ = (char)(0x80 | ((code >> 6) & 0x3F));
+    *p++ = (char)(0x80 | (code & 0x3F));
+    return p;
+}
+
+static inline char* putHalfBlock(int glyph, char* p)
+{
+    if (glyph == 0)
+    {
+        *p++ = DEAD_CELL_CHAR;
+        return p;
+    }
+    std::memcpy(p, HALF_BLOCKS[glyph], 3);
+    return p + 3;
+}
+
+// Whole buffer is written, short writes are continued
+static void writeAll(const char* data, size_t size)
+{
+    while (size > 0)
+    {
+#ifdef _WIN32
+        int written = _write(1, data, (unsigned int)size);
+#else
+        ssize_t written = write(1, data, size);
+#endif
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += written;
+        size -= (size_t)written;
+    }
+}
+
+FrameRenderer::FrameRenderer(GlyphMode glyphs)
+    : _glyphs(glyphs)
+{
+    _block_count = getPackedBlockCount(bestKernelIsa());
+#ifdef _WIN32
+    // Windows console understands ANSI escapes only when asked to
+    HANDLE out = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD console_mode = 0;
+    if (GetConsoleMode(out, &console_mode))
+        SetConsoleMode(out, console_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+}
+
+void FrameRenderer::SetGlyphs(GlyphMode glyphs) { _glyphs = glyphs; _shown_valid = false; }
+GlyphMode FrameRenderer::GetGlyphs()            { return _glyphs; }
+void FrameRenderer::SetDiff(bool diff)          { _diff = diff;   _shown_valid = false; }
+bool FrameRenderer::GetDiff()                   { return _diff;   }
+
+// Cells of field shown by viewport, every line of window but the last one is full
+FrameRenderer::Window FrameRenderer::windowOf(Field* field)
+{
+    int n = field->getN(), m = field->getM();
+    Window window;
+    window.x0 = std::max(0, std::min(_viewport.x, n - 1));
+    window.y0 = std::max(0, std::min(_viewport.y, m - 1));
+    window.x1 = _viewport.lines > 0
+        ? (int)std::min<long long>(n, window.x0 + (long long)_viewport.lines * rowsPerLine()) : n;
+    window.y1 = _viewport.columns > 0
+        ? (int)std::min<long long>(m, window.y0 + (long long)_viewport.columns * cellsPerChar()) : m;
+    return window;
+}
+
+int FrameRenderer::GetWidth(Field* field)
+{
+    Window window = windowOf(field);
+    return (window.y1 - window.y0 + cellsPerChar() - 1) / cellsPerChar();
+}
+
+void FrameRenderer::SetViewport(const Viewport& viewport)
+{
+    _viewport = viewport;
+    _viewport.zoom = std::max(1, viewport.zoom);
+}
+Viewport FrameRenderer::GetViewport() { return _viewport; }
+int FrameRenderer::GetRowsPerLine()   { return rowsPerLine();  }
+int FrameRenderer::GetCellsPerChar()  { return cellsPerChar(); }
+
+// Field rows per terminal line and cells per character in a row
+int FrameRenderer::rowsPerLine()
+{
+    if (_viewport.zoom > 1) return _viewport.zoom;
+    return _glyphs == GLYPH_BRAILLE ? 4 : (_glyphs == GLYPH_HALF_BLOCK ? 2 : 1);
+}
+int FrameRenderer::cellsPerChar()
+{
+    if (_viewport.zoom > 1) return _viewport.zoom;
+    return _glyphs == GLYPH_BRAILLE ? 2 : 1;
+}
+
+void FrameRenderer::Begin()
+{
+    _frame.clear();
+    if (_invalid)
+    {
+        _frame += ESC_CLEAR_SCREEN;
+        _shown_valid = false;
+    }
+    _frame += ESC_HOME;
+    _invalid = false;
+    _line = 0;
+}
+
+// Appends string literal without its terminating zero
+#define PUT_LITERAL(p, literal) (std::memcpy(p, literal, sizeof(literal) - 1), p += sizeof(literal) - 1)
+
+char* FrameRenderer::addAsciiRows(Field* field, char* p)
+{
+    const Window& w = _window;
+    for (int x = w.x0; x < w.x1; x++)
+    {
+        const uint64_t* row = field->getRow(x);
+        for (int y = w.y0; y < w.y1; y++)
+            *p++ = cellOf(row, y) ? ACTIVE_CELL_CHAR : DEAD_CELL_CHAR;
+        *p++ = END_OF_FIELD_CHAR;
+        PUT_LITERAL(p, ESC_CLEAR_LINE "\n");
+    }
+    return p;
+}
+
+// Rows x and x + 1 make one line, odd last row is drawn as upper halves
+char* FrameRenderer::addHalfBlockRows(Field* field, char* p)
+{
+    const Window& w = _window;
+    for (int x = w.x0; x < w.x1; x += 2)
+    {
+        const uint64_t* upper = field->getRow(x);
+        const uint64_t* lower = x + 1 < w.x1 ? field->getRow(x + 1) : nullptr;
+        for (int y = w.y0; y < w.y1; y++)
+            p = putHalfBlock(halfBlockOf(upper, lower, y), p);
+        *p++ = END_OF_FIELD_CHAR;
+        PUT_LITERAL(p, ESC_CLEAR_LINE "\n");
+    }
+    return p;
+}
+
+// 4 rows by 2 columns per character
+char* FrameRenderer::addBrailleRows(Field* field, char* p)
+{
+    const Window& w = _window;
+    for (int x = w.x0; x < w.x1; x += 4)
+    {
+        const uint64_t* rows[4];
+        for (int r = 0; r < 4; r++)
+            rows[r] = x + r < w.x1 ? field->getRow(x + r) : nullptr;
+        for (int y = w.y0; y < w.y1; y += 2)
+            p = putBraille(brailleDotsOf(rows, y, w.y1), p);
+        *p++ = END_OF_FIELD_CHAR;
+        PUT_LITERAL(p, ESC_CLEAR_LINE "\n");
+    }
+    return p;
+}
+
+// Every character is a zoom x zoom block, live cells of its rows are summed
+// by one block count per row, so only words of the window are read
+char* FrameRenderer::addDensityRows(Field* field, char* p)
+{
+    const Window& w = _window;
+    int zoom = _viewport.zoom;
+    int chars = (w.y1 - w.y0 + zoom - 1) / zoom;
+    _counts.resize((size_t)chars);
+    for (int x = w.x0; x < w.x1; x += zoom)
+    {
+        int x_end = std::min(w.x1, x + zoom);
+        std::fill(_counts.begin(), _counts.end(), 0);
+        for (int r = x; r < x_end; r++)
+            _block_count(field->getRow(r), w.y0, w.y1, zoom, _counts.data());
+        for (int c = 0; c < chars; c++)
+        {
+            int cells = (x_end - x) * (std::min(w.y1, w.y0 + (c + 1) * zoom) - (w.y0 + c * zoom));
+            // Any live cell shows at least the first non-blank level
+            int level = _counts[c] == 0 ? 0
+                : 1 + (int)((long long)_counts[c] * (DENSITY_LEVELS - 2) / cells);
+            *p++ = DENSITY_RAMP[level];
+        }
+        *p++ = END_OF_FIELD_CHAR;
+        PUT_LITERAL(p, ESC_CLEAR_LINE "\n");
+    }
+    return p;
+}
+
+// Character of window at terminal line and column of field
+char* FrameRenderer::putChar(Field* field, int line, int column, char* p)
+{
+    const Window& w = _window;
+    int x = w.x0 + line * rowsPerLine(), y = w.y0 + column * cellsPerChar();
+    switch (_glyphs)
+    {
+    case GLYPH_HALF_BLOCK:
+        return putHalfBlock(halfBlockOf(field->getRow(x), x + 1 < w.x1 ? field->getRow(x + 1) : nullptr, y), p);
+    case GLYPH_BRAILLE:
+    {
+        const uint64_t* rows[4];
+        for (int r = 0; r < 4; r++)
+            rows[r] = x + r < w.x1 ? field->getRow(x + r) : nullptr;
+        return putBraille(brailleDotsOf(rows, y, w.y1), p);
+    }
+    default:
+        *p++ = cellOf(field->getRow(x), y) ? ACTIVE_CELL_CHAR : DEAD_CELL_CHAR;
+        return p;
+    }
+}
+
+// Moves cursor to characters [from, to) of line and writes them
+void FrameRenderer::addRun(Field* field, int line, int from, int to)
+{
+    size_t start = _frame.size();
+    _frame.resize(start + ESC_MOVE_SIZE + (size_t)(to - from) * 3);
+    char* p = &_frame[start];
+    p += std::snprintf(p, ESC_MOVE_SIZE + 1, "\x1b[%d;%dH", _line + line + 1, from + 1);
+    for (int column = from; column < to; column++)
+        p = putChar(field, line, column, p);
+    _frame.resize((size_t)(p - _frame.data()));
+}
+
+// Cells that differ from shown window are found by XOR of packed words,
+// so unchanged parts of a line are skipped 64 cells at once
+void FrameRenderer::addChangedRows(Field* field)
+{
+    const Window& win = _window;
+    int rows_per_line = rowsPerLine(), cells_per_char = cellsPerChar();
+    int first_word = win.y0 >> 6, words = ((win.y1 - 1) >> 6) + 1 - first_word;
+    for (int line = 0; win.x0 + line * rows_per_line < win.x1; line++)
+    {
+        int x_from = win.x0 + line * rows_per_line;
+        int x_end = std::min(win.x1, x_from + rows_per_line);
+        // Changed characters [run_from, run_to), none if run_from < 0
+        int run_from = -1, run_to = -1;
+        for (int w = 0; w < words; w++)
+        {
+            uint64_t diff = 0;
+            for (int x = x_from; x < x_end; x++)
+                diff |= field->getRow(x)[first_word + w] ^ _shown[(size_t)(x - win.x0) * words + w];
+            for (; diff; diff &= diff - 1)
+            {
+                int y = (first_word + w) * 64 + lowestBit(diff);
+                if (y < win.y0) continue;
+                if (y >= win.y1) break;
+                int column = (y - win.y0) / cells_per_char;
+                // Second cell of the same braille character
+                if (column < run_to) continue;
+                if (run_from >= 0 && column - run_to > DIFF_RUN_GAP)
+                {
+                    addRun(field, line, run_from, run_to);
+                    run_from = -1;
+                }
+                if (run_from < 0) run_from = column;
+                run_to = column + 1;
+            }
+        }
+        if (run_from >= 0)
+            addRun(field, line, run_from, run_to);
+    }
+}
+
+// Words of window are kept to find changes of the next frame
+void FrameRenderer::keepShown(Field* field)
+{
+    const Window& win = _window;
+    int first_word = win.y0 >> 6, words = ((win.y1 - 1) >> 6) + 1 - first_word;
+    _shown.resize((size_t)(win.x1 - win.x0) * words);
+    for (int x = win.x0; x < win.x1; x++)
+        std::memcpy(&_shown[(size_t)(x - win.x0) * words], field->getRow(x) + first_word, words * sizeof(uint64_t));
+    _shown_window = win;
+    _shown_line = _line;
+    _shown_valid = true;
+}
+
+bool FrameRenderer::sameWindow(const Window& a, const Window& b)
+{
+    return a.x0 == b.x0 && a.x1 == b.x1 && a.y0 == b.y0 && a.y1 == b.y1;
+}
+
+// Buffer is grown to the upper bound of the frame once and filled through a pointer,
+// every glyph is at most 3 bytes
+void FrameRenderer::AddField(Field* field)
+{
+    _window = windowOf(field);
+    int lines = (_window.x1 - _window.x0 + rowsPerLine() - 1) / rowsPerLine();
+    int width = GetWidth(field);
+    bool density = _viewport.zoom > 1;
+    if (_diff && !density && _shown_valid && sameWindow(_shown_window, _window) && _shown_line == _line)
+    {
+        addChangedRows(field);
+        keepShown(field);
+        // Cursor to the line after bottom line, the rest of frame goes on from there
+        _line += lines + 1;
+        _frame += "\x1b[" + std::to_string(_line + 1) + ";1H";
+        return;
+    }
+
+    size_t start = _frame.size();
+    _frame.resize(start + (size_t)(lines + 1) * ((size_t)width * 3 + 16));
+    char* p = &_frame[start];
+    if (density)
+        p = addDensityRows(field, p);
+    else switch (_glyphs)
+    {
+    case GLYPH_HALF_BLOCK: p = addHalfBlockRows(field, p); break;
+    case GLYPH_BRAILLE:    p = addBrailleRows(field, p);   break;
+    default:               p = addAsciiRows(field, p);     break;
+    }
+    std::memset(p, BOTTOM_LINE_CHAR, (size_t)width);
+    p += width;
+    *p++ = END_OF_FIELD_CHAR;
+    PUT_LITERAL(p, ESC_CLEAR_LINE "\n");
+    _frame.resize((size_t)(p - _frame.data()));
+    if (_diff && !density)
+        keepShown(field);
+    else
+        _shown_valid = false;
+    _line += lines + 1;
+}
+
+void FrameRenderer::AddLine(const std::string& line)
+{
+    _frame += line;
+    _frame += ESC_CLEAR_LINE "\n";
+    _line++;
+}
+
+void FrameRenderer::AddPrompt(const std::string& text)
+{
+    _frame += text;
+    _frame += ESC_CLEAR_LINE;
+}
+
+void FrameRenderer::Flush()
+{
+    _frame += ESC_CLEAR_BELOW;
+    std::cout.flush();
+    writeAll(_frame.data(), _frame.size());
+    _bytes_written += _frame.size();
+    _frames_written++;
+}
+
+const std::string& FrameRenderer::GetFrame() { return _frame; }
+void FrameRenderer::Invalidate()             { _invalid = true; }
+
+uint64_t FrameRenderer::GetBytesWritten()  { return _bytes_written;  }
+uint64_t FrameRenderer::GetFramesWritten() { return _frames_written; }
+size_t FrameRenderer::GetAverageFrameBytes()
+{
+    return _frames_written == 0 ? 0 : (size_t)(_bytes_written / _frames_written);
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "PackedKernels.h"
+
+class Field;
+
+// Characters of frame: ASCII, Unicode half blocks or braille
+// GLYPH_ASCII      - one cell per character, ACTIVE_CELL_CHAR for live cells
+// GLYPH_HALF_BLOCK - two rows per character: upper, lower or full block
+// GLYPH_BRAILLE    - 4 rows by 2 columns per braille character
+enum GlyphMode
+{
+    GLYPH_ASCII,
+    GLYPH_HALF_BLOCK,
+    GLYPH_BRAILLE
+};
+
+// Parses "ascii", "half" or "braille", false for anything else
+bool glyphModeFromName(const std::string& name, GlyphMode* mode);
+
+// Size of terminal attached to standard output, false if there is none
+bool terminalSize(int* lines, int* columns);
+
+// Part of field drawn by FrameRenderer:
+// cells from row x, column y, at most lines x columns terminal characters,
+// 0 - no limit. Zoom above 1 draws density view, every character
+// shows the share of live cells in a zoom x zoom block
+typedef struct Viewport_s
+{
+    int x = 0, y = 0;
+    int lines = 0, columns = 0;
+    int zoom = 1;
+} Viewport;
+
+/// <summary>
+/// Builds terminal frames in one buffer and writes each with a single write().
+/// Cursor is moved home with ANSI escapes instead of clearing the screen
+/// by a shell command, every line clears its own tail, so a frame
+/// overwrites the previous one in place without flicker.
+/// Buffer keeps its capacity between frames.
+/// In diff mode the last drawn field is kept and the next frame
+/// moves the cursor only to characters that changed since then.
+/// Only words of field inside the viewport are read
+/// </summary>
+class FrameRenderer
+{
+private:
+    // Cells drawn by AddField(): rows [x0, x1), columns [y0, y1)
+    typedef struct Window_s
+    {
+        int x0, x1, y0, y1;
+    } Window;
+
+    std::string _frame;
+    GlyphMode _glyphs;
+    // Whole screen is cleared by the next frame
+    bool _invalid = true;
+    Viewport _viewport;
+    Window _window;
+    PackedBlockCount _block_count;
+    // Live cells of every character of density line
+    std::vector<int> _counts;
+    // Terminal line of frame where the next text goes
+    int _line = 0;
+    uint64_t _bytes_written = 0, _frames_written = 0;
+
+    // Diff mode: words of the last drawn window at frame line _shown_line
+    bool _diff = false;
+    bool _shown_valid = false;
+    std::vector<uint64_t> _shown;
+    Window _shown_window;
+    int _shown_line = 0;
+
+    // Rows of field written at p, returns end of written text
+    char* addAsciiRows(Field* field, char* p);
+    char* addHalfBlockRows(Field* field, char* p);
+    char* addBrailleRows(Field* field, char* p);
+    char* addDensityRows(Field* field, char* p);
+    Window windowOf(Field* field);
+    static bool sameWindow(const Window& a, const Window& b);
+    int rowsPerLine();
+    int cellsPerChar();
+    char* putChar(Field* field, int line, int column, char* p);
+    void addRun(Field* field, int line, int from, int to);
+    // Writes characters that differ from the shown field
+    void addChangedRows(Field* field);
+    void keepShown(Field* field);
+
+public:
+    FrameRenderer(GlyphMode glyphs = GLYPH_ASCII);
+
+    void SetGlyphs(GlyphMode glyphs);
+    GlyphMode GetGlyphs();
+    // Diff mode redraws only changed characters of a field drawn at the same place
+    void SetDiff(bool diff);
+    bool GetDiff();
+    // Zoom below 1 is taken as 1
+    void SetViewport(const Viewport& viewport);
+    Viewport GetViewport();
+    // Terminal characters per line of field in viewport
+    int GetWidth(Field* field);
+    // Field rows per terminal line and cells per character, set by glyphs and zoom
+    int GetRowsPerLine();
+    int GetCellsPerChar();
+
+    // Starts frame at top left corner of terminal
+    void Begin();
+    // Field with right border and bottom line
+    void AddField(Field* field);
+    void AddLine(const std::string& line);
+    // Text without line break, cursor stays after it
+    void AddPrompt(const std::string& text);
+    // Clears the rest of the screen and writes frame with one call
+    // Output buffered in std::cout is flushed first
+    void Flush();
+    // Frame built since Begin()
+    const std::string& GetFrame();
+    // Next frame clears the whole screen, for example after other output scrolled it
+    void Invalidate();
+
+    // Bytes and frames written by Flush()
+    uint64_t GetBytesWritten();
+    uint64_t GetFramesWritten();
+    size_t GetAverageFrameBytes();
+};
@@ -0,0 +1,399 @@
+#include "Snapshot.h"
+#include "Life.h"
+#include <ostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+
+#define LZ_MIN_MATCH 4
+#define LZ_MAX_OFFSET 65535
+#define LZ_HASH_BITS 14
+// Last bytes of block are always literals, match search reads ahead safely
+#define LZ_TAIL 8
+
+#pragma region Bytes
+
+static void putU16(std::vector<uint8_t>& out, uint16_t v)
+{
+    out.push_back((uint8_t)v);
+    out.push_back((uint8_t)(v >> 8));
+}
+
+static void putU32(std::vector<uint8_t>& out, uint32_t v)
+{
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void putU64(std::vector<uint8_t>& out, uint64_t v)
+{
+    size_t at = out.size();
+    out.resize(at + 8);
+    for (int i = 0; i < 8; i++) out[at + i] = (uint8_t)(v >> (8 * i));
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static void putString(std::vector<uint8_t>& out, const std::string& str)
+{
+    putU32(out, (uint32_t)str.size());
+    out.insert(out.end(), str.begin(), str.end());
+}
+
+// Bounds-checked little-endian reader of snapshot bytes
+class SnapshotReader
+{
+private:
+    const uint8_t* _data;
+    size_t _size;
+    size_t _pos = 0;
+
+public:
+    SnapshotReader(const uint8_t* data, size_t size) : _data(data), _size(size) {}
+
+    const uint8_t* Take(size_t bytes)
+    {
+        if (bytes > _size - _pos) throw std::invalid_argument("Snapshot is truncated");
+        const uint8_t* p = _data + _pos;
+        _pos += bytes;
+        return p;
+    }
+
+    uint64_t Get(int bytes)
+    {
+        const uint8_t* p = Take(bytes);
+        uint64_t v = 0;
+        for (int i = 0; i < bytes; i++) v |= (uint64_t)p[i] << (8 * i);
+        return v;
+    }
+
+    uint64_t Varint()
+    {
+        uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            uint8_t byte = *Take(1);
+            v |= (uint64_t)(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return v;
+        }
+        throw std::invalid_argument("Snapshot varint is too long");
+    }
+
+    std::string String()
+    {
+        uint32_t length = (uint32_t)Get(4);
+        const uint8_t* p = Take(length);
+        return std::string((const char*)p, length);
+    }
+
+    bool AtEnd() { return _pos == _size; }
+};
+
+#pragma endregion
+
+#pragma region Compression
+
+static inline uint32_t read32(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t lzHash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Length past 15 of token nibble, as bytes of 255 and remainder
+static void putLength(std::vector<uint8_t>& out, size_t length)
+{
+    for (; length >= 255; length -= 255) out.push_back(255);
+    out.push_back((uint8_t)length);
+}
+
+// Sequence: token (literal length, match length - 4), literals,
+// u16 match offset, extra match length. Last sequence has literals only
+static void putSequence(std::vector<uint8_t>& out, const uint8_t* literals, size_t literal_length,
+                        size_t offset, size_t match_length)
+{
+    size_t extra = match_length ? match_length - LZ_MIN_MATCH : 0;
+    out.push_back((uint8_t)((std::min<size_t>(literal_length, 15) << 4) | std::min<size_t>(extra, 15)));
+    if (literal_length >= 15) putLength(out, literal_length - 15);
+    out.insert(out.end(), literals, literals + literal_length);
+    if (match_length == 0) return;
+    putU16(out, (uint16_t)offset);
+    if (extra >= 15) putLength(out, extra - 15);
+}
+
+// Greedy LZ77: positions of 4-byte sequences are kept in hash table,
+// first match found is extended as far as it goes.
+// Search step grows while nothing matches, so random data passes quickly
+void lzCompress(const uint8_t* src, size_t size, std::vector<uint8_t>& out)
+{
+    // Position + 1 of last sequence with this hash, 0 if none
+    std::vector<uint32_t> table((size_t)1 << LZ_HASH_BITS, 0);
+    size_t limit = size > LZ_TAIL ? size - LZ_TAIL : 0;
+    size_t ip = 0, anchor = 0;
+    unsigned misses = 0;
+
+    while (ip < limit)
+    {
+        uint32_t v = read32(src + ip);
+        uint32_t h = lzHash(v);
+        size_t ref = table[h];
+        table[h] = (uint32_t)(ip + 1);
+        if (ref == 0 || ip - (ref - 1) > LZ_MAX_OFFSET || read32(src + ref - 1) != v)
+        {
+            ip += 1 + (misses++ >> 6);
+            continue;
+        }
+        ref--;
+
+        size_t length = LZ_MIN_MATCH;
+        while (ip + length + 8 <= limit)
+        {
+            uint64_t a, b;
+            std::memcpy(&a, src + ref + length, 8);
+            std::memcpy(&b, src + ip + length, 8);
+            if (a != b) break;
+            length += 8;
+        }
+        while (ip + length < limit && src[ref + length] == src[ip + length])
+            length++;
+
+        putSequence(out, src + anchor, ip - anchor, ip - ref, length);
+        ip += length;
+        anchor = ip;
+        misses = 0;
+    }
+    putSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+static size_t getLength(const uint8_t* src, size_t size, size_t& ip)
+{
+    size_t length = 0;
+    for (;;)
+    {
+        if (ip >= size) throw std::invalid_argument("Compressed block is corrupted");
+        uint8_t byte = src[ip++];
+        length += byte;
+        if (byte != 255) return length;
+    }
+}
+
+void lzDecompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size)
+{
+    size_t ip = 0, op = 0;
+    for (;;)
+    {
+        if (ip >= size) throw std::invalid_argument("Compressed block is corrupted");
+        uint8_t token = src[ip++];
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15) literal_length += getLength(src, size, ip);
+        if (literal_length > size - ip || literal_length > dst_size - op)
+            throw std::invalid_argument("Compressed block is corrupted");
+        std::memcpy(dst + op, src + ip, literal_length);
+        ip += literal_length;
+        op += literal_length;
+        if (ip == size) break;
+
+        if (size - ip < 2) throw std::invalid_argument("Compressed block is corrupted");
+        size_t offset = src[ip] | ((size_t)src[ip + 1] << 8);
+        ip += 2;
+        size_t match_length = token & 15;
+        if (match_length == 15) match_length += getLength(src, size, ip);
+        match_length += LZ_MIN_MATCH;
+        if (offset == 0 || offset > op || match_length > dst_size - op)
+            throw std::invalid_argument("Compressed block is corrupted");
+
+        // Overlapping match repeats last offset bytes
+        const uint8_t* from = dst + op - offset;
+        if (offset >= match_length)
+            std::memcpy(dst + op, from, match_length);
+        else
+            for (size_t i = 0; i < match_length; i++) dst[op + i] = from[i];
+        op += match_length;
+    }
+    if (op != dst_size) throw std::invalid_argument("Compressed block is corrupted");
+}
+
+#pragma endregion
+
+#pragma region Snapshot
+
+bool isSnapshot(const char* data, size_t size)
+{
+    return size >= SNAPSHOT_MAGIC_SIZE && std::memcmp(data, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) == 0;
+}
+
+// Payload is cut into blocks of about SNAPSHOT_BLOCK_SIZE bytes,
+// every block is compressed alone if compression helps
+static void writeBlock(std::ostream& out, std::vector<uint8_t>& raw, bool compress, std::vector<uint8_t>& packed)
+{
+    if (raw.empty()) return;
+    const std::vector<uint8_t>* stored = &raw;
+    if (compress)
+    {
+        packed.clear();
+        lzCompress(raw.data(), raw.size(), packed);
+        if (packed.size() < raw.size()) stored = &packed;
+    }
+    std::vector<uint8_t> sizes;
+    putU32(sizes, (uint32_t)raw.size());
+    putU32(sizes, (uint32_t)stored->size());
+    out.write((const char*)sizes.data(), sizes.size());
+    out.write((const char*)stored->data(), stored->size());
+    raw.clear();
+}
+
+static void putRow(std::vector<uint8_t>& out, const uint64_t* row, size_t words, bool rle)
+{
+    if (!rle)
+    {
+        for (size_t w = 0; w < words; w++) putU64(out, row[w]);
+        return;
+    }
+    size_t w = 0;
+    while (w < words)
+    {
+        size_t zeros = w;
+        while (w < words && row[w] == 0) w++;
+        zeros = w - zeros;
+        size_t literals = w;
+        while (w < words && row[w] != 0) w++;
+        literals = w - literals;
+        putVarint(out, zeros);
+        putVarint(out, literals);
+        for (size_t i = w - literals; i < w; i++) putU64(out, row[i]);
+    }
+}
+
+void writeSnapshot(std::ostream& out, SnapshotHeader header, Field* field)
+{
+    size_t words = field->getRowWords();
+    size_t nonzero = 0;
+    for (int x = 0; x < field->getN(); x++)
+    {
+        const uint64_t* row = field->getRow(x);
+        for (size_t w = 0; w < words; w++) nonzero += row[w] != 0;
+    }
+    bool rle = nonzero * 2 < (size_t)field->getN() * words;
+    bool compress = (header.flags & SNAPSHOT_FLAG_COMPRESSED) != 0;
+
+    header.version = SNAPSHOT_VERSION;
+    header.flags = (rle ? SNAPSHOT_FLAG_RLE : 0) | (compress ? SNAPSHOT_FLAG_COMPRESSED : 0);
+    header.n = (uint32_t)field->getN();
+    header.m = (uint32_t)field->getM();
+
+    std::vector<uint8_t> head(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + SNAPSHOT_MAGIC_SIZE);
+    putU32(head, header.version);
+    putU32(head, header.flags);
+    putU32(head, header.n);
+    putU32(head, header.m);
+    putU16(head, header.b_mask);
+    putU16(head, header.s_mask);
+    putU64(head, header.generation);
+    putString(head, header.name);
+    putString(head, header.comment);
+    out.write((const char*)head.data(), head.size());
+
+    std::vector<uint8_t> raw, packed;
+    raw.reserve(SNAPSHOT_BLOCK_SIZE + words * 10 + 32);
+    for (int x = 0; x < field->getN(); x++)
+    {
+        putRow(raw, field->getRow(x), words, rle);
+        if (raw.size() >= SNAPSHOT_BLOCK_SIZE) writeBlock(out, raw, compress, packed);
+    }
+    writeBlock(out, raw, compress, packed);
+
+    std::vector<uint8_t> end;
+    putU32(end, 0);
+    putU32(end, 0);
+    out.write((const char*)end.data(), end.size());
+}
+
+SnapshotHeader readSnapshot(const char* data, size_t size, Field* field)
+{
+    if (!isSnapshot(data, size)) throw std::invalid_argument("Not a snapshot file");
+    SnapshotReader in((const uint8_t*)data, size);
+    in.Take(SNAPSHOT_MAGIC_SIZE);
+
+    SnapshotHeader header;
+    header.version = (uint32_t)in.Get(4);
+    if (header.version != SNAPSHOT_VERSION)
+        throw std::invalid_argument("Unsupported snapshot version");
+    header.flags = (uint32_t)in.Get(4);
+    header.n = (uint32_t)in.Get(4);
+    header.m = (uint32_t)in.Get(4);
+    header.b_mask = (uint16_t)in.Get(2);
+    header.s_mask = (uint16_t)in.Get(2);
+    header.generation = in.Get(8);
+    header.name = in.String();
+    header.comment = in.String();
+    if (header.n == 0 || header.m == 0 || header.n > INT_MAX || header.m > INT_MAX)
+        throw std::invalid_argument("Snapshot field size is invalid");
+
+    std::vector<uint8_t> payload;
+    for (;;)
+    {
+        size_t raw_length = (size_t)in.Get(4);
+        size_t stored_length = (size_t)in.Get(4);
+        if (raw_length == 0) break;
+        const uint8_t* stored = in.Take(stored_length);
+        size_t at = payload.size();
+        payload.resize(at + raw_length);
+        if (stored_length == raw_length)
+            std::memcpy(payload.data() + at, stored, raw_length);
+        else
+            lzDecompress(stored, stored_length, payload.data() + at, raw_length);
+    }
+
+    // Size of header is checked against payload before anything is allocated:
+    // packed rows take exactly 8 bytes per word, RLE rows at least 2 bytes
+    size_t row_words = ((size_t)header.m + 63) / 64;
+    bool payload_fits = (header.flags & SNAPSHOT_FLAG_RLE)
+        ? payload.size() / 2 >= header.n
+        : payload.size() / 8 / row_words == header.n && payload.size() % (8 * row_words) == 0;
+    if (!payload_fits)
+        throw std::invalid_argument("Snapshot field size does not match payload");
+
+    field->Resize((int)header.n, (int)header.m);
+    size_t words = field->getRowWords();
+    uint64_t last_mask = field->getLastWordMask();
+    SnapshotReader rows(payload.data(), payload.size());
+    for (int x = 0; x < field->getN(); x++)
+    {
+        uint64_t* row = field->getRow(x);
+        size_t w = 0;
+        while (w < words)
+        {
+            size_t literals = words - w;
+            if (header.flags & SNAPSHOT_FLAG_RLE)
+            {
+                uint64_t zeros = rows.Varint();
+                uint64_t count = rows.Varint();
+                if (zeros + count == 0 || zeros > words - w || count > words - w - zeros)
+                    throw std::invalid_argument("Snapshot row is corrupted");
+                w += (size_t)zeros;
+                literals = (size_t)count;
+            }
+            for (size_t i = 0; i < literals; i++) row[w++] = rows.Get(8);
+        }
+        row[words - 1] &= last_mask;
+    }
+    if (!rows.AtEnd()) throw std::invalid_argument("Snapshot payload is corrupted");
+    field->markModified();
+    return header;
+}
+
+#pragma endregion
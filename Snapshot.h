@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstdint>
+#include <cstddef>
+
+class Field;
+
+// Binary snapshot of field
+//
+// Layout, all integers little-endian:
+//   char[8]  SNAPSHOT_MAGIC
+//   u32      version
+//   u32      flags (SNAPSHOT_FLAG_*)
+//   u32      n, m
+//   u16      birth mask, survival mask
+//   u64      generation
+//   u32      name length, name bytes
+//   u32      comment length, comment bytes
+//   blocks   u32 raw length, u32 stored length, stored bytes;
+//            stored length == raw length means block is not compressed,
+//            block with raw length 0 ends the payload
+//
+// Payload is rows 0..n-1 of field, every row holds (m + 63) / 64 words:
+//   packed - words as u64
+//   RLE    - pairs of varints (zero words, literal words) followed by
+//            literal words as u64, until the row is covered
+#define SNAPSHOT_MAGIC "LIFESNAP"
+#define SNAPSHOT_MAGIC_SIZE 8
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_EXTENSION ".snap"
+
+#define SNAPSHOT_FLAG_RLE        1
+#define SNAPSHOT_FLAG_COMPRESSED 2
+
+// Uncompressed size of payload block
+#define SNAPSHOT_BLOCK_SIZE (1 << 20)
+
+typedef struct SnapshotHeader_s
+{
+    uint32_t version = SNAPSHOT_VERSION;
+    uint32_t flags = 0;
+    uint32_t n = 0, m = 0;
+    uint16_t b_mask = 0, s_mask = 0;
+    uint64_t generation = 0;
+    std::string name;
+    std::string comment;
+} SnapshotHeader;
+
+// True if data starts with snapshot magic
+bool isSnapshot(const char* data, size_t size);
+
+// Writes field with header, n and m of header are taken from field
+// RLE rows are used when most of the words are empty,
+// SNAPSHOT_FLAG_COMPRESSED of header.flags turns on block compression
+void writeSnapshot(std::ostream& out, SnapshotHeader header, Field* field);
+
+// Reads snapshot into field, field is resized to snapshot size
+// Throws std::invalid_argument if data is not a valid snapshot
+SnapshotHeader readSnapshot(const char* data, size_t size, Field* field);
+
+// LZ77 block compression, byte-oriented with 64 KiB window
+// Appends compressed src to out
+void lzCompress(const uint8_t* src, size_t size, std::vector<uint8_t>& out);
+// Decompresses src into exactly dst_size bytes of dst
+// Throws std::invalid_argument if src is corrupted
+void lzDecompress(const uint8_t* src, size_t size, uint8_t* dst, size_t dst_size);
@@ -0,0 +1,188 @@
+#include "SoupSearch.h"
+#include <atomic>
+#include <fstream>
+#include <filesystem>
+#include <random>
+#include <algorithm>
+#include <exception>
+
+SoupSearch::SoupSearch(int threads)
+{
+    if (threads > 1)
+        _pool = new ThreadPool(threads);
+    for (int i = 0; i < threads; i++)
+        _workers.push_back(new Worker());
+}
+
+SoupSearch::~SoupSearch()
+{
+    for (Worker* w : _workers)
+        delete w;
+    delete _pool;
+}
+
+void SoupSearch::SetGenerations(uint64_t generations) { _generations = generations; }
+
+void SoupSearch::setSoup(Worker* worker, uint64_t seed)
+{
+    Field& field = worker->field;
+    field.Resize(SOUP_FIELD_SIZE, SOUP_FIELD_SIZE);
+    std::mt19937_64 rng(seed);
+    int corner = (SOUP_FIELD_SIZE - SOUP_SIZE) / 2;
+    for (int x = 0; x < SOUP_SIZE; x++)
+    {
+        uint64_t bits = rng();
+        for (int y = 0; y < SOUP_SIZE; y++)
+            if ((bits >> y) & 1)
+                field.setAt(corner + x, corner + y, true);
+    }
+    worker->logic.SetRule(digitMask(3), digitMask(23));
+    worker->logic.SetGeneration(0);
+}
+
+void SoupSearch::runBoard(Worker* worker, SoupResult& result)
+{
+    Logic& logic = worker->logic;
+    uint64_t limit = logic.GetGeneration() + _generations;
+    worker->cycles.Reset();
+    worker->cycles.Observe(&logic);
+    while (logic.GetGeneration() < limit)
+    {
+        logic.Tick();
+        if (worker->cycles.Observe(&logic)) break;
+    }
+    result.generation = logic.GetGeneration();
+    result.period = worker->cycles.GetPeriod();
+    result.start = worker->cycles.GetStart();
+    result.population = logic.GetPopulation();
+    logic.GetBoundingBox(&result.min_x, &result.min_y, &result.max_x, &result.max_y);
+}
+
+// Boards are taken one by one from shared counter, so slow boards do not hold others
+template <class BoardSetup>
+std::vector<SoupResult> SoupSearch::run(size_t count, BoardSetup setup)
+{
+    std::vector<SoupResult> results(count);
+    std::atomic<size_t> next(0);
+    auto job = [&](int worker)
+    {
+        for (size_t i = next++; i < count; i = next++)
+        {
+            try
+            {
+                setup(_workers[worker], i);
+                runBoard(_workers[worker], results[i]);
+            }
+            catch (const std::exception& e)
+            {
+                results[i] = SoupResult();
+                results[i].error = e.what();
+            }
+        }
+    };
+    if (_pool != nullptr)
+        _pool->RunOnAll(job);
+    else
+        job(0);
+    return results;
+}
+
+std::vector<SoupResult> SoupSearch::Run(const std::vector<SoupJob>& jobs)
+{
+    return run(jobs.size(), [this, &jobs](Worker* worker, size_t i)
+    {
+        if (jobs[i].file.empty())
+            setSoup(worker, jobs[i].seed);
+        else
+        {
+            PresetParser prepar(jobs[i].file);
+            worker->field.Resize(SOUP_FIELD_SIZE, SOUP_FIELD_SIZE);
+            worker->logic.LoadPreset(&prepar);
+        }
+    });
+}
+
+std::vector<SoupResult> SoupSearch::RunSeeds(uint64_t first, uint64_t last)
+{
+    if (last < first) return std::vector<SoupResult>();
+    if (last - first >= (uint64_t)SIZE_MAX / sizeof(SoupResult))
+        throw std::invalid_argument("Seed range is too large");
+    return run((size_t)(last - first) + 1, [this, first](Worker* worker, size_t i)
+    {
+        setSoup(worker, first + i);
+    });
+}
+
+std::vector<SoupJob> SoupSearch::JobsFromSource(std::string source)
+{
+    std::vector<SoupJob> jobs;
+    std::error_code ec;
+    if (std::filesystem::is_directory(source, ec))
+    {
+        for (const auto& entry : std::filesystem::directory_iterator(source, ec))
+        {
+            if (!entry.is_regular_file()) continue;
+            SoupJob job;
+            job.file = entry.path().string();
+            jobs.push_back(job);
+        }
+        // Directory order is unspecified, results are listed by name
+        std::sort(jobs.begin(), jobs.end(),
+                  [](const SoupJob& a, const SoupJob& b) { return a.file < b.file; });
+        return jobs;
+    }
+
+    std::ifstream manifest(source);
+    if (!manifest.is_open())
+        throw std::invalid_argument("Can not read batch source " + source);
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+            line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        SoupJob job;
+        job.file = line;
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+// Line of one board after its name
+static void writeResult(std::ostream& out, const SoupResult& r)
+{
+    if (!r.error.empty())
+    {
+        out << "\terror\t" << r.error << '\n';
+        return;
+    }
+    out << '\t' << r.generation << '\t' << r.population
+        << '\t' << r.period << '\t' << r.start
+        << '\t' << r.min_x << '\t' << r.min_y
+        << '\t' << r.max_x << '\t' << r.max_y << '\n';
+}
+
+#define RESULTS_HEADER "#board\tgeneration\tpopulation\tperiod\tstart\tmin_x\tmin_y\tmax_x\tmax_y\n"
+
+void SoupSearch::WriteResults(std::ostream& out, const std::vector<SoupJob>& jobs,
+                              const std::vector<SoupResult>& results)
+{
+    out << RESULTS_HEADER;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        if (jobs[i].file.empty()) out << "seed:" << jobs[i].seed;
+        else                      out << jobs[i].file;
+        writeResult(out, results[i]);
+    }
+}
+
+void SoupSearch::WriteSeedResults(std::ostream& out, uint64_t first,
+                                  const std::vector<SoupResult>& results)
+{
+    out << RESULTS_HEADER;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        out << "seed:" << first + i;
+        writeResult(out, results[i]);
+    }
+}
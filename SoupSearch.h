@@ -0,0 +1,87 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstdint>
+#include "Life.h"
+#include "CycleDetector.h"
+
+// Board of a random soup and the soup in its center
+#define SOUP_FIELD_SIZE 128
+#define SOUP_SIZE 16
+// Generations a board runs for if it does not settle into a cycle
+#define SOUP_GENERATIONS 20000
+
+// One board of the batch: preset file or random soup made from seed
+typedef struct SoupJob_s
+{
+    std::string file;
+    uint64_t seed = 0;
+} SoupJob;
+
+// Final state of a board
+// period is 0 if the board did not repeat itself within the generation limit,
+// bounding box is empty (min > max) for dead boards
+typedef struct SoupResult_s
+{
+    uint64_t generation = 0;
+    uint64_t population = 0;
+    uint64_t period = 0;
+    uint64_t start = 0;
+    int min_x = 0, min_y = 0, max_x = -1, max_y = -1;
+    std::string error;
+} SoupResult;
+
+/// <summary>
+/// Runs many boards concurrently on a thread pool.
+/// Every worker owns one Field, Logic and CycleDetector that are reused
+/// for all boards it takes, so a board of the same size as the previous
+/// one costs no allocation and no process start. A board stops when its
+/// cycle is confirmed or after the generation limit
+/// </summary>
+class SoupSearch
+{
+private:
+    typedef struct Worker_s
+    {
+        Field field;
+        Logic logic;
+        CycleDetector cycles;
+        Worker_s() : logic(&field, 3, 23) {}
+    } Worker;
+
+    ThreadPool* _pool = nullptr;
+    std::vector<Worker*> _workers;
+    uint64_t _generations = SOUP_GENERATIONS;
+
+    // Random soup of seed in the center of worker's field
+    void setSoup(Worker* worker, uint64_t seed);
+    // Runs board set up in worker's field until cycle or generation limit
+    void runBoard(Worker* worker, SoupResult& result);
+    // Runs count boards, setup(worker, i) sets up board i
+    template <class BoardSetup>
+    std::vector<SoupResult> run(size_t count, BoardSetup setup);
+
+public:
+    SoupSearch(int threads = 1);
+    SoupSearch(const SoupSearch&) = delete;
+    SoupSearch& operator=(const SoupSearch&) = delete;
+    ~SoupSearch();
+
+    void SetGenerations(uint64_t generations);
+    // Results in order of jobs
+    std::vector<SoupResult> Run(const std::vector<SoupJob>& jobs);
+    // Results of seeds first..last, soup of a seed is made when a worker takes it
+    // Throws std::invalid_argument if range does not fit in memory
+    std::vector<SoupResult> RunSeeds(uint64_t first, uint64_t last);
+
+    // Jobs for every file of directory, or for every line of manifest file
+    // Throws std::invalid_argument if source can not be read
+    static std::vector<SoupJob> JobsFromSource(std::string source);
+    // Tab separated line per board, header line starts with '#'
+    static void WriteResults(std::ostream& out, const std::vector<SoupJob>& jobs,
+                             const std::vector<SoupResult>& results);
+    // Same for results of RunSeeds(first, ...)
+    static void WriteSeedResults(std::ostream& out, uint64_t first,
+                                 const std::vector<SoupResult>& results);
+};
@@ -0,0 +1,237 @@
+#include "SparseField.h"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+// Chunk coordinate of cell coordinate, rounded towards minus infinity
+#define CHUNK_OF(v) ((v) >> 6)
+#define CHUNK_BIT(v) ((v) & 63)
+#define INITIAL_TABLE_SIZE 64
+
+static inline size_t hashChunk(int64_t cx, int64_t cy)
+{
+    uint64_t h = (uint64_t)cx * 0x9E3779B97F4A7C15ull ^ (uint64_t)cy * 0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    return (size_t)h;
+}
+
+#pragma region ChunkMap
+
+SparseField::ChunkMap::ChunkMap()
+{
+    _table.assign(INITIAL_TABLE_SIZE, -1);
+}
+
+// Slot holding chunk (cx, cy) or free slot where it belongs
+size_t SparseField::ChunkMap::slotOf(int64_t cx, int64_t cy)
+{
+    size_t mask = _table.size() - 1;
+    size_t slot = hashChunk(cx, cy) & mask;
+    while (_table[slot] != -1)
+    {
+        const Chunk& c = _chunks[_table[slot]];
+        if (c.cx == cx && c.cy == cy) break;
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void SparseField::ChunkMap::grow()
+{
+    _table.assign(_table.size() * 2, -1);
+    for (size_t i = 0; i < _chunks.size(); i++)
+        _table[slotOf(_chunks[i].cx, _chunks[i].cy)] = (int32_t)i;
+}
+
+SparseField::Chunk* SparseField::ChunkMap::Find(int64_t cx, int64_t cy)
+{
+    int32_t i = _table[slotOf(cx, cy)];
+    return i == -1 ? nullptr : &_chunks[i];
+}
+
+// Existing chunk or new empty one
+SparseField::Chunk* SparseField::ChunkMap::Insert(int64_t cx, int64_t cy)
+{
+    size_t slot = slotOf(cx, cy);
+    if (_table[slot] != -1)
+        return &_chunks[_table[slot]];
+
+    _table[slot] = (int32_t)_chunks.size();
+    _chunks.push_back(Chunk());
+    Chunk& c = _chunks.back();
+    c.cx = cx;
+    c.cy = cy;
+    std::memset(c.rows, 0, sizeof(c.rows));
+    if (_chunks.size() * 2 > _table.size())
+        grow();
+    return &_chunks.back();
+}
+
+// Drops all chunks, keeps allocated memory
+void SparseField::ChunkMap::Clear()
+{
+    _chunks.clear();
+    std::fill(_table.begin(), _table.end(), -1);
+}
+
+size_t SparseField::ChunkMap::Size() { return _chunks.size(); }
+SparseField::Chunk& SparseField::ChunkMap::At(size_t i) { return _chunks[i]; }
+
+#pragma endregion
+
+// b_mask/s_mask: bit k is set if k neighbours give birth/survival
+SparseField::SparseField(uint16_t b_mask, uint16_t s_mask)
+{
+    SetRule(b_mask, s_mask);
+    _kernel = getPackedRowKernel(bestKernelIsa());
+}
+
+void SparseField::SetRule(uint16_t b_mask, uint16_t s_mask)
+{
+    if (b_mask & 1)
+        throw std::invalid_argument("SparseField does not support B0 rules");
+    _b_mask = b_mask;
+    _s_mask = s_mask;
+}
+
+void SparseField::SetCell(int64_t x, int64_t y, bool val)
+{
+    Chunk* c = val ? _chunks.Insert(CHUNK_OF(x), CHUNK_OF(y))
+                   : _chunks.Find(CHUNK_OF(x), CHUNK_OF(y));
+    if (c == nullptr) return;
+    uint64_t bit = (uint64_t)1 << CHUNK_BIT(y);
+    if (val) c->rows[CHUNK_BIT(x)] |= bit;
+    else     c->rows[CHUNK_BIT(x)] &= ~bit;
+}
+
+bool SparseField::GetCell(int64_t x, int64_t y)
+{
+    Chunk* c = _chunks.Find(CHUNK_OF(x), CHUNK_OF(y));
+    if (c == nullptr) return false;
+    return (c->rows[CHUNK_BIT(x)] >> CHUNK_BIT(y)) & 1;
+}
+
+void SparseField::Clear()
+{
+    _chunks.Clear();
+    _generation = 0;
+}
+
+#pragma region Evolution
+
+// Chunks that may hold live cells in next generation:
+// every live chunk and neighbours touched by its border cells.
+// Without B0 a cell is born only next to a live cell
+void SparseField::collectCandidates()
+{
+    _candidates.clear();
+    for (size_t i = 0; i < _chunks.Size(); i++)
+    {
+        const Chunk& c = _chunks.At(i);
+        uint64_t west = 0, east = 0, any = 0;
+        for (int r = 0; r < CHUNK_SIZE; r++)
+        {
+            west |= c.rows[r] & 1;
+            east |= c.rows[r] >> 63;
+            any |= c.rows[r];
+        }
+        if (!any) continue;
+
+        uint64_t north = c.rows[0], south = c.rows[CHUNK_SIZE - 1];
+        _candidates.emplace_back(c.cx, c.cy);
+        if (north) _candidates.emplace_back(c.cx - 1, c.cy);
+        if (south) _candidates.emplace_back(c.cx + 1, c.cy);
+        if (west)  _candidates.emplace_back(c.cx, c.cy - 1);
+        if (east)  _candidates.emplace_back(c.cx, c.cy + 1);
+        if (north & 1)         _candidates.emplace_back(c.cx - 1, c.cy - 1);
+        if (north >> 63)       _candidates.emplace_back(c.cx - 1, c.cy + 1);
+        if (south & 1)         _candidates.emplace_back(c.cx + 1, c.cy - 1);
+        if (south >> 63)       _candidates.emplace_back(c.cx + 1, c.cy + 1);
+    }
+    std::sort(_candidates.begin(), _candidates.end());
+    _candidates.erase(std::unique(_candidates.begin(), _candidates.end()), _candidates.end());
+}
+
+// Next generation of chunk (cx, cy), false if it is empty
+// Chunk rows with one row above and below are gathered together with
+// west and east neighbour words, so packed row kernel sees plain rows of 3 words
+bool SparseField::stepChunk(int64_t cx, int64_t cy, uint64_t* out)
+{
+    uint64_t rows[(CHUNK_SIZE + 2) * 3];
+    std::memset(rows, 0, sizeof(rows));
+    for (int dx = -1; dx <= 1; dx++)
+    {
+        for (int dy = -1; dy <= 1; dy++)
+        {
+            Chunk* c = _chunks.Find(cx + dx, cy + dy);
+            if (c == nullptr) continue;
+            // Chunk rows landing on gathered rows 0 .. CHUNK_SIZE + 1
+            int from = (dx == -1) ? CHUNK_SIZE - 1 : 0;
+            int to = (dx == 1) ? 1 : CHUNK_SIZE;
+            int shift = (dx == -1) ? -(CHUNK_SIZE - 1) : (dx == 0 ? 1 : CHUNK_SIZE + 1);
+            for (int r = from; r < to; r++)
+                rows[(r + shift) * 3 + dy + 1] = c->rows[r];
+        }
+    }
+
+    uint64_t any = 0;
+    uint64_t next[3];
+    for (int r = 0; r < CHUNK_SIZE; r++)
+    {
+        _kernel(rows + r * 3, rows + (r + 1) * 3, rows + (r + 2) * 3, next,
+                1, 2, 3, 3 * CHUNK_SIZE, ~(uint64_t)0, _b_mask, _s_mask);
+        out[r] = next[1];
+        any |= next[1];
+    }
+    return any != 0;
+}
+
+void SparseField::step()
+{
+    collectCandidates();
+    _next.Clear();
+    uint64_t out[CHUNK_SIZE];
+    for (const auto& key : _candidates)
+    {
+        if (!stepChunk(key.first, key.second, out)) continue;
+        Chunk* c = _next.Insert(key.first, key.second);
+        std::memcpy(c->rows, out, sizeof(out));
+    }
+    std::swap(_chunks, _next);
+    _generation++;
+}
+
+void SparseField::Step(uint64_t generations)
+{
+    for (uint64_t i = 0; i < generations; i++)
+        step();
+}
+
+#pragma endregion
+
+uint64_t SparseField::GetGeneration() { return _generation; }
+
+uint64_t SparseField::GetPopulation()
+{
+    uint64_t population = 0;
+    for (size_t i = 0; i < _chunks.Size(); i++)
+        for (int r = 0; r < CHUNK_SIZE; r++)
+            population += bitCount(_chunks.At(i).rows[r]);
+    return population;
+}
+
+size_t SparseField::GetChunkCount() { return _chunks.Size(); }
+
+// Calls visit(x, y) for every live cell
+void SparseField::ForEachCell(const std::function<void(int64_t, int64_t)>& visit)
+{
+    for (size_t i = 0; i < _chunks.Size(); i++)
+    {
+        const Chunk& c = _chunks.At(i);
+        for (int r = 0; r < CHUNK_SIZE; r++)
+            for (uint64_t w = c.rows[r]; w; w &= w - 1)
+                visit(c.cx * CHUNK_SIZE + r, c.cy * CHUNK_SIZE + lowestBit(w));
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+#include "PackedKernels.h"
+
+// Side of a square chunk of SparseField, one uint64_t per chunk row
+#define CHUNK_SIZE 64
+
+/// <summary>
+/// Sparse field over unbounded plane.
+/// Only chunks of CHUNK_SIZE x CHUNK_SIZE cells holding live cells are stored,
+/// found through open addressing hash table by chunk coordinates.
+/// Chunks appear when activity reaches them and are dropped when they die out,
+/// so memory follows population instead of bounding box area.
+/// Works for any totalistic B/S rule without B0
+/// </summary>
+class SparseField
+{
+private:
+    // Chunk (cx, cy) holds cells (cx * 64 + r, cy * 64 + c):
+    // bit c of rows[r], same packing as Field rows
+    typedef struct Chunk_s
+    {
+        int64_t cx, cy;
+        uint64_t rows[CHUNK_SIZE];
+    } Chunk;
+
+    // Chunk storage with open addressing index of chunk coordinates
+    class ChunkMap
+    {
+    private:
+        std::vector<Chunk> _chunks;
+        // Index in _chunks or -1 for free slot
+        std::vector<int32_t> _table;
+
+        size_t slotOf(int64_t cx, int64_t cy);
+        void grow();
+
+    public:
+        ChunkMap();
+        // nullptr if chunk is not stored
+        Chunk* Find(int64_t cx, int64_t cy);
+        // Existing chunk or new empty one
+        Chunk* Insert(int64_t cx, int64_t cy);
+        // Drops all chunks, keeps allocated memory
+        void Clear();
+        size_t Size();
+        Chunk& At(size_t i);
+    };
+
+    ChunkMap _chunks;
+    // Next generation is built here and swapped with _chunks
+    ChunkMap _next;
+    // Chunks to evaluate in current step
+    std::vector<std::pair<int64_t, int64_t>> _candidates;
+    uint16_t _b_mask, _s_mask;
+    PackedRowKernel _kernel;
+    uint64_t _generation = 0;
+
+    // Chunks that may hold live cells in next generation
+    void collectCandidates();
+    // Next generation of chunk (cx, cy), false if it is empty
+    bool stepChunk(int64_t cx, int64_t cy, uint64_t* out);
+    void step();
+
+public:
+    // b_mask/s_mask: bit k is set if k neighbours give birth/survival
+    // Throws std::invalid_argument for B0 rules
+    SparseField(uint16_t b_mask, uint16_t s_mask);
+    // Changes rule, cells are kept
+    void SetRule(uint16_t b_mask, uint16_t s_mask);
+
+    // Cell (x, y): x is row, y is column, any 64-bit coordinates
+    // Chunk emptied by SetCell is dropped by the next step
+    void SetCell(int64_t x, int64_t y, bool val);
+    bool GetCell(int64_t x, int64_t y);
+    void Clear();
+
+    void Step(uint64_t generations);
+
+    uint64_t GetGeneration();
+    uint64_t GetPopulation();
+    size_t GetChunkCount();
+
+    // Calls visit(x, y) for every live cell
+    void ForEachCell(const std::function<void(int64_t, int64_t)>& visit);
+};
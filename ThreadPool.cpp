@@ -0,0 +1,112 @@
+#include "ThreadPool.h"
+#include <stdexcept>
+
+ThreadPool::ThreadPool(int threads)
+{
+    if (threads < 1)
+        throw std::invalid_argument("Thread pool needs at least one thread");
+    for (int i = 1; i < threads; i++)
+        _workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _start_cv.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+}
+
+void ThreadPool::workerLoop(int index)
+{
+    uint64_t seen = 0;
+    while (true)
+    {
+        const std::function<void(int)>* job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _start_cv.wait(lock, [&] { return _stop || _round != seen; });
+            if (_stop) return;
+            seen = _round;
+            job = _job;
+        }
+
+        (*job)(index);
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_pending == 0)
+            _done_cv.notify_one();
+    }
+}
+
+int ThreadPool::GetThreads() { return (int)_workers.size() + 1; }
+
+// Runs job(worker) on every worker, worker = 0..GetThreads()-1
+// Returns when all workers have finished
+void ThreadPool::RunOnAll(const std::function<void(int)>& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _job = &job;
+        _pending = (int)_workers.size();
+        _round++;
+    }
+    _start_cv.notify_all();
+
+    job(0);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done_cv.wait(lock, [&] { return _pending == 0; });
+}
+
+// Empties queues and sets number of workers
+void WorkStealingScheduler::Reset(int workers)
+{
+    while ((int)_queues.size() < workers)
+        _queues.emplace_back(new TaskQueue());
+    _queues.resize(workers);
+    for (auto& queue : _queues)
+    {
+        queue->tasks.clear();
+        queue->head = 0;
+    }
+}
+
+// Adds task to worker's queue
+void WorkStealingScheduler::Push(int worker, int task)
+{
+    _queues[worker]->tasks.push_back(task);
+}
+
+bool WorkStealingScheduler::popOwn(int worker, int& task)
+{
+    TaskQueue& queue = *_queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.size() == queue.head) return false;
+    task = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingScheduler::steal(int thief, int& task)
+{
+    int workers = (int)_queues.size();
+    for (int i = 1; i < workers; i++)
+    {
+        TaskQueue& queue = *_queues[(thief + i) % workers];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.size() == queue.head) continue;
+        task = queue.tasks[queue.head++];
+        return true;
+    }
+    return false;
+}
+
+// Next task for worker, false if every queue is empty
+bool WorkStealingScheduler::Next(int worker, int& task)
+{
+    return popOwn(worker, task) || steal(worker, task);
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+#include <memory>
+
+/// <summary>
+/// Persistent pool of worker threads.
+/// Calling thread works as worker 0, so pool of N threads
+/// starts N - 1 additional threads once and reuses them for every run
+/// </summary>
+class ThreadPool
+{
+private:
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _start_cv, _done_cv;
+    // Job of current run, owned by caller of RunOnAll
+    const std::function<void(int)>* _job = nullptr;
+    uint64_t _round = 0;
+    int _pending = 0;
+    bool _stop = false;
+
+    void workerLoop(int index);
+
+public:
+    ThreadPool(int threads);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    int GetThreads();
+    // Runs job(worker) on every worker, worker = 0..GetThreads()-1
+    // Returns when all workers have finished
+    void RunOnAll(const std::function<void(int)>& job);
+};
+
+/// <summary>
+/// Task queues for work stealing: every worker owns a queue of task ids,
+/// takes tasks from its back and, when it runs dry, steals from the
+/// front of other workers' queues.
+/// Queues keep their storage between runs
+/// </summary>
+class WorkStealingScheduler
+{
+private:
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::vector<int> tasks;
+        size_t head = 0;
+    };
+    std::vector<std::unique_ptr<TaskQueue>> _queues;
+
+    bool popOwn(int worker, int& task);
+    bool steal(int thief, int& task);
+
+public:
+    // Empties queues and sets number of workers
+    // Not thread-safe, call between runs
+    void Reset(int workers);
+    // Adds task to worker's queue, not thread-safe, call between runs
+    void Push(int worker, int task);
+    // Next task for worker, false if every queue is empty
+    bool Next(int worker, int& task);
+};
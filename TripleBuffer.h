@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+
+/// <summary>
+/// Lock-free triple buffer for one writer and one reader thread.
+/// Writer fills Back() and publishes it, reader takes the newest
+/// published slot with Update() and reads Front().
+/// Neither side ever waits: writer always has a free slot,
+/// reader skips the slots published between two of its updates
+/// </summary>
+template <typename T>
+class TripleBuffer
+{
+private:
+    // Middle slot index, FRESH_BIT is set when it holds data the reader has not taken
+    static const int FRESH_BIT = 4;
+    static const int SLOT_MASK = 3;
+
+    T _slots[3];
+    std::atomic<int> _middle{ 1 };
+    // Owned by writer and reader threads respectively
+    int _back = 0, _front = 2;
+
+public:
+    // Slot to be filled by writer
+    T& Back() { return _slots[_back]; }
+
+    // Makes back slot the newest one, writer continues with the previous middle slot
+    void Publish()
+    {
+        _back = _middle.exchange(_back | FRESH_BIT, std::memory_order_acq_rel) & SLOT_MASK;
+    }
+
+    // Takes the newest published slot as front one
+    // False if nothing was published since the last update, front slot stays then
+    bool Update()
+    {
+        if (!(_middle.load(std::memory_order_acquire) & FRESH_BIT))
+            return false;
+        _front = _middle.exchange(_front, std::memory_order_acq_rel) & SLOT_MASK;
+        return true;
+    }
+
+    // Slot read by reader
+    T& Front() { return _slots[_front]; }
+};